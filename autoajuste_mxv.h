@@ -0,0 +1,320 @@
+/*
+ ============================================================================
+ Name        : autoajuste_mxv.h
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Eleccion de la distribucion de la matriz en tiempo de
+    ejecucion (--layout auto de matriz_x_vector.cpp): por filas, por columnas
+    o por submatrices, y en ese caso la forma de la malla.
+
+ Unas sondas cortas miden la latencia y el ancho de banda entre dos procesos
+ (ping-pong entre el proceso 0 y el ultimo, que con el reparto habitual de
+ mpirun estan en nodos distintos si hay mas de uno) y la capacidad del nucleo
+ local para el ancho de bloque de cada distribucion (midePotencia, la misma
+ medida que --calibrate). Con ellas un modelo de latencia y ancho de banda
+ (alfa + beta * bytes por mensaje, con arboles binomiales en las colectivas)
+ estima el tiempo de un producto con cada distribucion y se elige la mas
+ rapida:
+ - filas: MPI_Bcast de todo x y MPI_Gatherv de y.
+ - columnas: MPI_Scatterv de x, MPI_Reduce_scatter de y y MPI_Gatherv.
+ - malla R x C: MPI_Scatterv y MPI_Bcast de x, MPI_Reduce y MPI_Gatherv de y,
+   con mensajes de n / C y n / R posiciones.
+ Con y repartido solo quedan el MPI_Allgatherv de x y el MPI_Reduce_scatter
+ de y de cada distribucion.
+
+ El calculo se mide con los k vectores, asi que su peso frente a la
+ comunicacion crece con k igual que en el producto real.
+
+ Si se da un fichero (--tune-cache), la eleccion se guarda en el (una linea
+ por problema) con clave n, k, tipo, P, y repartido y una firma de los nodos
+ (los nombres de los procesadores de todos los procesos, en orden), que
+ identifica el hostfile y la colocacion de los procesos. Las siguientes
+ ejecuciones con la misma clave y el mismo fichero no repiten las sondas. Sin
+ fichero no se escribe nada.
+ ============================================================================
+ */
+
+#ifndef AUTOAJUSTE_MXV_H
+#define AUTOAJUSTE_MXV_H
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mpi.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "colectivas_mxv.h"
+#include "distribuida_mxv.h"
+#include "generador_mxv.h"
+#include "kernel_mxv.h"
+
+struct DisposicionMxv {
+    DistribucionMatriz distribucion;
+    int filasMalla; // Malla de procesos (P x 1 por filas, 1 x P por columnas)
+    int columnasMalla;
+    double segundos; // Tiempo estimado de un producto (comunicacion y calculo)
+};
+
+inline DisposicionMxv disposicionMxv(DistribucionMatriz distribucion, int filasMalla, int columnasMalla) {
+    DisposicionMxv disposicion = {distribucion, filasMalla, columnasMalla, 0};
+    return disposicion;
+}
+
+inline const char *nombreDistribucion(DistribucionMatriz distribucion) {
+    switch (distribucion) {
+        case DISTRIBUCION_FILAS: return "rows";
+        case DISTRIBUCION_COLUMNAS: return "columns";
+        default: return "grid";
+    }
+}
+
+inline bool distribucionDesdeNombre(const std::string &nombre, DistribucionMatriz &distribucion) {
+    if (nombre == "rows") {
+        distribucion = DISTRIBUCION_FILAS;
+    } else if (nombre == "columns") {
+        distribucion = DISTRIBUCION_COLUMNAS;
+    } else if (nombre == "grid") {
+        distribucion = DISTRIBUCION_BLOQUES;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/*
+ Capacidad de calculo de este proceso, en filas de n elementos por segundo
+ multiplicadas por k vectores, medida con el nucleo local (con todos sus
+ hilos) sobre un bloque pequeño durante unos 50 ms. Sirve para repartir las filas en nodos de distinta
+ generacion (calibrar) y para estimar el calculo de cada distribucion.
+ */
+template <typename T, typename S>
+double midePotencia(long n, int k = 1) {
+    const int filas = 64;
+    S *bloque = new S [filas * n];
+    T *entrada = new T [n * k];
+    T *resultado = new T [filas * k];
+    generaBloque(0, n, 0, filas, 0, n, bloque, n);
+    for (long j = 0; j < n; j++) {
+        for (int v = 0; v < k; v++) {
+            entrada[j * k + v] = valorVector<T>(0, j, v);
+        }
+    }
+    long repeticiones = 0;
+    double tInicio = MPI_Wtime(), tFin;
+    do {
+        productoBloque(bloque, n, entrada, resultado, filas, n, k);
+        repeticiones++;
+        tFin = MPI_Wtime();
+    } while (tFin - tInicio < 0.05);
+    delete [] bloque;
+    delete [] entrada;
+    delete [] resultado;
+    return repeticiones * filas / (tFin - tInicio);
+}
+
+struct ParametrosRed {
+    double latencia; // Segundos por mensaje (alfa)
+    double segundosPorByte; // Inverso del ancho de banda (beta)
+};
+
+/*
+ Ping-pong entre el proceso 0 y el ultimo con mensajes de 1 byte (latencia) y
+ de 'bytes' bytes (ancho de banda). Devuelve el resultado en todos los procesos.
+ */
+inline ParametrosRed midePingPong(long bytes, MPI_Comm comunicador) {
+    int id, P;
+    MPI_Comm_rank(comunicador, &id);
+    MPI_Comm_size(comunicador, &P);
+    double medidas[2] = {0, 0}; // Ida y vuelta de 1 byte y de 'bytes' bytes
+    if (P > 1) {
+        const int repeticiones[2] = {50, 5};
+        const long tamanos[2] = {1, bytes};
+        std::vector<char> mensaje(bytes);
+        for (int m = 0; m < 2; m++) {
+            MPI_Barrier(comunicador);
+            double tInicio = MPI_Wtime();
+            for (int r = 0; r < repeticiones[m]; r++) {
+                if (id == 0) {
+                    MPI_Send(&mensaje[0], tamanos[m], MPI_CHAR, P - 1, ETIQUETA_SONDA, comunicador);
+                    MPI_Recv(&mensaje[0], tamanos[m], MPI_CHAR, P - 1, ETIQUETA_SONDA, comunicador, MPI_STATUS_IGNORE);
+                } else if (id == P - 1) {
+                    MPI_Recv(&mensaje[0], tamanos[m], MPI_CHAR, 0, ETIQUETA_SONDA, comunicador, MPI_STATUS_IGNORE);
+                    MPI_Send(&mensaje[0], tamanos[m], MPI_CHAR, 0, ETIQUETA_SONDA, comunicador);
+                }
+            }
+            medidas[m] = (MPI_Wtime() - tInicio) / repeticiones[m];
+        }
+        MPI_Bcast(medidas, 2, MPI_DOUBLE, 0, comunicador);
+    }
+    ParametrosRed red;
+    red.latencia = medidas[0] / 2;
+    red.segundosPorByte = std::max(0.0, (medidas[1] / 2 - red.latencia) / bytes);
+    return red;
+}
+
+// Pasos de un arbol binomial de P procesos
+inline int pasosArbol(int P) {
+    int pasos = 0;
+    while ((1 << pasos) < P) {
+        pasos++;
+    }
+    return pasos;
+}
+
+/*
+ Tiempo de las comunicaciones de un producto con la malla R x C (P x 1 por
+ filas, 1 x P por columnas) para un vector de 'bytes' bytes (los k vectores).
+ */
+inline double costeComunicacion(DistribucionMatriz distribucion, int R, int C, double bytes, bool yRepartido,
+        const ParametrosRed &red) {
+    const double a = red.latencia, b = red.segundosPorByte;
+    int P = R * C;
+    if (distribucion == DISTRIBUCION_FILAS) {
+        if (yRepartido) {
+            return pasosArbol(P) * a + bytes * (P - 1) / P * b; // Allgatherv
+        }
+        return pasosArbol(P) * (a + bytes * b) // Bcast
+                + (P - 1) * a + bytes * (P - 1) / P * b; // Gatherv
+    }
+    if (distribucion == DISTRIBUCION_COLUMNAS) {
+        double reduccion = pasosArbol(P) * a + bytes * (P - 1) / P * b; // Reduce_scatter
+        if (yRepartido) {
+            return reduccion; // Cada trozo de y es ya el trozo de x del mismo proceso
+        }
+        return 2 * ((P - 1) * a + bytes * (P - 1) / P * b) + reduccion; // Scatterv y Gatherv
+    }
+    if (yRepartido) {
+        return pasosArbol(R) * a + bytes / C * (R - 1) / R * b // Allgatherv por columnas
+                + pasosArbol(C) * a + bytes / R * (C - 1) / C * b; // Reduce_scatter por filas
+    }
+    return (C - 1) * a + bytes * (C - 1) / C * b // Scatterv por la primera fila
+            + pasosArbol(R) * (a + bytes / C * b) // Bcast por columnas
+            + pasosArbol(C) * (a + bytes / R * b) // Reduce por filas
+            + (R - 1) * a + bytes * (R - 1) / R * b; // Gatherv por la primera columna
+}
+
+/*
+ Firma de los nodos: hash FNV-1a de los nombres de los procesadores de todos
+ los procesos en orden de rango, en hexadecimal (solo en el proceso 0).
+ */
+inline std::string firmaNodos(MPI_Comm comunicador) {
+    int id, P, longitud;
+    MPI_Comm_rank(comunicador, &id);
+    MPI_Comm_size(comunicador, &P);
+    char nombre[MPI_MAX_PROCESSOR_NAME] = {0};
+    MPI_Get_processor_name(nombre, &longitud);
+    std::vector<char> nombres(id == 0 ? (long) P * MPI_MAX_PROCESSOR_NAME : 0);
+    MPI_Gather(nombre, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, id == 0 ? &nombres[0] : NULL, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, 0, comunicador);
+    if (id != 0) {
+        return "";
+    }
+    unsigned long long hash = 14695981039346656037ULL;
+    for (int r = 0; r < P; r++) {
+        for (const char *c = &nombres[(long) r * MPI_MAX_PROCESSOR_NAME]; *c != 0; c++) {
+            hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+        }
+        hash = (hash ^ '\n') * 1099511628211ULL;
+    }
+    char texto[17];
+    snprintf(texto, sizeof(texto), "%016llx", hash);
+    return texto;
+}
+
+/*
+ Elige la distribucion para n x n y k vectores en todos los procesos de
+ 'comunicador' (es colectiva). Si 'cache' no es vacio, busca antes la eleccion
+ en ese fichero y, si no esta, la añade. 'candidatos' devuelve en el proceso 0
+ la estimacion de cada distribucion (vacio si la eleccion sale del fichero).
+ */
+template <typename T, typename S>
+DisposicionMxv eligeDisposicion(long n, int k, bool yRepartido, const std::string &tipo, const std::string &cache,
+        MPI_Comm comunicador, std::vector<DisposicionMxv> &candidatos) {
+    int id, P;
+    MPI_Comm_rank(comunicador, &id);
+    MPI_Comm_size(comunicador, &P);
+    candidatos.clear();
+
+    // Clave del problema: n k tipo P yRepartido firma
+    std::string firma = firmaNodos(comunicador);
+    std::ostringstream clave;
+    clave << n << " " << k << " " << tipo << " " << P << " " << (yRepartido ? 1 : 0) << " " << firma;
+
+    DisposicionMxv eleccion = disposicionMxv(DISTRIBUCION_FILAS, P, 1);
+    int encontrada = 0;
+    if (id == 0 && !cache.empty()) {
+        std::ifstream fichero(cache.c_str());
+        std::string linea;
+        while (std::getline(fichero, linea)) {
+            if (linea.compare(0, clave.str().size() + 1, clave.str() + " ") != 0) continue;
+            std::istringstream resto(linea.substr(clave.str().size() + 1));
+            std::string nombre;
+            int filas, columnas;
+            double segundos;
+            if (resto >> nombre >> filas >> columnas >> segundos && distribucionDesdeNombre(nombre, eleccion.distribucion)
+                    && filas * columnas == P) {
+                eleccion.filasMalla = filas;
+                eleccion.columnasMalla = columnas;
+                eleccion.segundos = segundos;
+                encontrada = 1;
+            }
+        }
+    }
+    MPI_Bcast(&encontrada, 1, MPI_INT, 0, comunicador);
+    if (encontrada) {
+        int datos[3] = {eleccion.distribucion, eleccion.filasMalla, eleccion.columnasMalla};
+        MPI_Bcast(datos, 3, MPI_INT, 0, comunicador);
+        eleccion.distribucion = (DistribucionMatriz) datos[0];
+        eleccion.filasMalla = datos[1];
+        eleccion.columnasMalla = datos[2];
+        return eleccion;
+    }
+
+    // Candidatos: filas, columnas y cada malla R x C con R, C > 1
+    candidatos.push_back(disposicionMxv(DISTRIBUCION_FILAS, P, 1));
+    if (P > 1) {
+        candidatos.push_back(disposicionMxv(DISTRIBUCION_COLUMNAS, 1, P));
+    }
+    for (int R = 2; R <= P / 2; R++) {
+        if (P % R == 0) {
+            candidatos.push_back(disposicionMxv(DISTRIBUCION_BLOQUES, R, P / R));
+        }
+    }
+
+    // Sondas: red entre dos procesos y nucleo local para cada ancho de bloque (el del proceso mas lento)
+    double bytes = (double) n * k * sizeof(T);
+    ParametrosRed red = midePingPong(std::max(1L, std::min((long) bytes, 1L << 23)), comunicador);
+    std::map<long, double> potencias; // Filas por segundo (con los k vectores) para cada ancho
+    for (size_t c = 0; c < candidatos.size(); c++) {
+        long ancho = std::max(1L, n / candidatos[c].columnasMalla);
+        if (potencias.count(ancho)) continue;
+        double potencia = midePotencia<T, S>(ancho, k), minima;
+        MPI_Allreduce(&potencia, &minima, 1, MPI_DOUBLE, MPI_MIN, comunicador);
+        potencias[ancho] = minima;
+    }
+    for (size_t c = 0; c < candidatos.size(); c++) {
+        DisposicionMxv &candidato = candidatos[c];
+        long ancho = std::max(1L, n / candidato.columnasMalla);
+        double alto = (double) (n + candidato.filasMalla - 1) / candidato.filasMalla;
+        candidato.segundos = alto / potencias[ancho] // Producto local con los k vectores
+                + costeComunicacion(candidato.distribucion, candidato.filasMalla, candidato.columnasMalla, bytes, yRepartido, red);
+        if (c == 0 || candidato.segundos < eleccion.segundos) {
+            eleccion = candidato;
+        }
+    }
+
+    if (id == 0 && !cache.empty()) {
+        std::ofstream fichero(cache.c_str(), std::ios::app);
+        fichero << clave.str() << " " << nombreDistribucion(eleccion.distribucion) << " " << eleccion.filasMalla << " "
+                << eleccion.columnasMalla << " " << eleccion.segundos << "\n";
+    }
+    if (id != 0) {
+        candidatos.clear();
+    }
+    return eleccion;
+}
+
+#endif
@@ -0,0 +1,103 @@
+/*
+ ============================================================================
+ Name        : bench_kernel_mxv.cpp
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Micro-benchmark del nucleo local de kernel_mxv.h.
+    Compara, para cada tipo de elemento, el bucle original de los programas
+    (una fila cada vez, un acumulador) con el nucleo teselado en cada juego de
+    instrucciones disponible. Muestra el tiempo por producto, el ancho de banda
+    efectivo (bytes de la matriz leidos por segundo) y la ganancia. Las filas
+    "int64/int16" y similares guardan la matriz en el segundo tipo (--storage
+    de los programas) y la ganancia es respecto al bucle original con la
+    matriz en el primero.
+
+ Build: g++ -O2 bench_kernel_mxv.cpp -o bench_kernel
+ Run: ./bench_kernel <filas> <columnas> [repeticiones]
+ ============================================================================
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+
+#include "kernel_mxv.h"
+
+using namespace std;
+
+// Devuelve el mejor tiempo (en segundos) de 'repeticiones' ejecuciones
+template <typename S, typename T>
+double mideProducto(bool simple, IsaNucleo isa, const S *A, const T *x, T *y, long filas, long columnas, int repeticiones) {
+    double mejor = 1e30;
+    for (int r = 0; r < repeticiones; r++) {
+        chrono::steady_clock::time_point inicio = chrono::steady_clock::now();
+        if (simple) {
+            productoLocalSimple(A, columnas, x, y, filas, columnas);
+        } else {
+            productoLocal(A, columnas, x, y, filas, columnas, isa);
+        }
+        chrono::steady_clock::time_point fin = chrono::steady_clock::now();
+        double t = chrono::duration<double>(fin - inicio).count();
+        if (t < mejor) mejor = t;
+    }
+    return mejor;
+}
+
+// Con S distinto de T el nucleo lee la matriz guardada en S y el bucle original la de T
+template <typename T, typename S>
+void comparaTipo(const char *nombre, long filas, long columnas, int repeticiones) {
+    vector<T> A(filas * columnas), x(columnas), y(filas), referencia(filas);
+    srand(1);
+    for (long i = 0; i < filas * columnas; i++) {
+        A[i] = (T) (rand() % 1000);
+    }
+    for (long j = 0; j < columnas; j++) {
+        x[j] = (T) (rand() % 100);
+    }
+    vector<S> almacen(A.begin(), A.end());
+
+    double bytes = (double) filas * columnas * sizeof(T);
+    double tSimple = mideProducto(true, ISA_GENERICO, A.data(), x.data(), referencia.data(), filas, columnas, repeticiones);
+    cout << setw(12) << nombre << setw(10) << "original" << setw(14) << tSimple * 1e3
+         << setw(12) << bytes / tSimple / 1e9 << setw(10) << 1.0 << endl;
+
+    bytes = (double) filas * columnas * sizeof(S);
+    IsaNucleo mejor = detectaIsa();
+    for (int isa = ISA_GENERICO; isa <= mejor; isa++) {
+        double t = mideProducto(false, (IsaNucleo) isa, almacen.data(), x.data(), y.data(), filas, columnas, repeticiones);
+        bool correcto = true;
+        for (long i = 0; i < filas; i++) {
+            double d = (double) y[i] - (double) referencia[i];
+            if (d < 0) d = -d;
+            if (d > 1e-3 * (referencia[i] < 0 ? -referencia[i] : referencia[i]) + 1e-6) correcto = false;
+        }
+        cout << setw(12) << nombre << setw(10) << nombreIsa((IsaNucleo) isa) << setw(14) << t * 1e3
+             << setw(12) << bytes / t / 1e9 << setw(10) << tSimple / t
+             << (correcto ? "" : "  RESULTADO DISTINTO") << endl;
+    }
+}
+
+int main(int argc, char * argv[]) {
+    if (argc < 3) {
+        cout << "Uso: bench_kernel <filas> <columnas> [repeticiones]" << endl;
+        return (0);
+    }
+    long filas = atol(argv[1]);
+    long columnas = atol(argv[2]);
+    int repeticiones = (argc > 3) ? atoi(argv[3]) : 10;
+
+    cout << "Matriz local de " << filas << " x " << columnas << ", mejor de " << repeticiones << " repeticiones" << endl;
+    cout << setw(12) << "tipo" << setw(10) << "nucleo" << setw(14) << "tiempo (ms)"
+         << setw(12) << "GB/s" << setw(10) << "ganancia" << endl;
+    comparaTipo<int, int>("int32", filas, columnas, repeticiones);
+    comparaTipo<long, long>("int64", filas, columnas, repeticiones);
+    comparaTipo<float, float>("float", filas, columnas, repeticiones);
+    comparaTipo<double, double>("double", filas, columnas, repeticiones);
+    comparaTipo<long, int>("int64/int32", filas, columnas, repeticiones);
+    comparaTipo<long, short>("int64/int16", filas, columnas, repeticiones);
+    comparaTipo<double, float>("double/float", filas, columnas, repeticiones);
+    comparaTipo<double, short>("double/int16", filas, columnas, repeticiones);
+}
@@ -0,0 +1,61 @@
+#!/bin/sh
+# ============================================================================
+# Name        : bench_mxv.sh
+# Author      : Jose Saldaña Mercado
+# Copyright   : GNU Open Souce and Free license
+# Description : Barrido de rendimiento de los programas de producto matriz-vector.
+#    Ejecuta mxv (1d, 1d_columnas con --layout columns y auto con --layout
+#    auto) y bi_mxv (2d) para cada combinacion de n, numero de
+#    procesos, descomposicion y tipo de dato, con repeticiones de calentamiento,
+#    y añade al fichero CSV (y JSON Lines) el minimo, la mediana y el percentil 95
+#    de cada fase (ver fases_mxv.h). La semilla es fija para que las ejecuciones
+#    se puedan repetir. El resultado se comprueba con Freivalds (--verify) para
+#    no repetir cada producto de forma secuencial en el proceso 0. Un tipo de
+#    la forma "int64/int16" guarda la matriz en el segundo (--storage), y asi
+#    aparece en la columna 'tipo' del CSV.
+#
+# Build: make mxv bi_mxv
+# Run: ./bench_mxv.sh [resultados.csv]
+#    Las listas se cambian con variables de entorno, por ejemplo:
+#    N="4000 8000" PROCESOS="4 16" DESCOMPOSICIONES="1d 1d_columnas 2d auto" TIPOS="int64 int64/int16 double" ./bench_mxv.sh
+#    MPIRUN="mpirun --oversubscribe" ARGUMENTOS="--iterations 10 --rhs 4" ./bench_mxv.sh
+# ============================================================================
+
+CSV=${1:-resultados_mxv.csv}
+JSON=${JSON:-${CSV%.csv}.json}
+N=${N:-"2000 4000 8000"}
+PROCESOS=${PROCESOS:-"1 2 4"}
+DESCOMPOSICIONES=${DESCOMPOSICIONES:-"1d 2d"}
+TIPOS=${TIPOS:-"int32 int64 float double"}
+CALENTAMIENTO=${CALENTAMIENTO:-2}
+REPETICIONES=${REPETICIONES:-10}
+ARGUMENTOS=${ARGUMENTOS:-"--iterations 5"}
+MPIRUN=${MPIRUN:-mpirun}
+SEMILLA=${SEMILLA:-12345}
+VERIFICACION=${VERIFICACION:-freivalds}
+
+for descomposicion in $DESCOMPOSICIONES; do
+    opcionesDescomposicion=""
+    case $descomposicion in
+        1d) programa=./mxv ;;
+        1d_columnas) programa=./mxv; opcionesDescomposicion="--layout columns" ;;
+        auto) programa=./mxv; opcionesDescomposicion="--layout auto" ;;
+        2d) programa=./bi_mxv ;;
+        *) echo "Descomposicion desconocida: $descomposicion" >&2; exit 1 ;;
+    esac
+    for p in $PROCESOS; do
+        for n in $N; do
+            for tipo in $TIPOS; do
+                case $tipo in
+                    */*) opcionesTipo="--dtype ${tipo%/*} --storage ${tipo#*/}" ;;
+                    *) opcionesTipo="--dtype $tipo" ;;
+                esac
+                echo "== $descomposicion, P = $p, n = $n, $tipo"
+                $MPIRUN -np "$p" $programa "$n" $opcionesDescomposicion $opcionesTipo --seed "$SEMILLA" --verify "$VERIFICACION" \
+                    --warmup "$CALENTAMIENTO" --repeat "$REPETICIONES" \
+                    --csv "$CSV" --json "$JSON" $ARGUMENTOS | grep -E "^(Hubo|No hubo) errores"
+            done
+        done
+    done
+done
+echo "Resultados en $CSV y $JSON"
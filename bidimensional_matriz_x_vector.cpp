@@ -5,18 +5,36 @@
  Version     :
  Copyright   : GNU Open Souce and Free license
  Description : Multiplicacion de Matrix por Vector.
-    Multiplica un vector por una matriz, repartiendo la matriz en submatrices cuadradas que procesa cada proceso.
-
- Build: mpicxx bidimensional_matriz_x_vector.cpp -o bi_mxv
- Run: mpirun --oversubscribe -np 4 bi_mxv <n>
+    Multiplica un vector por una matriz, repartiendo la matriz en submatrices que procesa cada proceso.
+
+ Build: make bi_mxv (enlaza con libmxv, ver Makefile)
+ Run: mpirun --oversubscribe -np 4 bi_mxv <n> [--iterations K] [--tolerance eps] [--rhs k]
+        [--dtype int32|int64|float|double] [--storage int16|int32|float] [--compress]
+        [--threads T] [--seed S] [--generate-local] [--grid RxC]
+        [--warmup W] [--repeat R] [--csv f] [--json f]
+        [--verify full|freivalds|none] [--abft] [--profile] [--trace f] [--distributed-y] [--persistent] [--topology]
+      mpirun --oversubscribe -np 4 bi_mxv --file <fichero> [--mmap | --stream F] [opciones]
+
+ Los procesos forman una malla de R x C (--grid RxC, o la que elige
+ MPI_Dims_create) y el producto lo hace libmxv (ejecutaPrograma de
+ programa_mxv.h) con DISTRIBUCION_BLOQUES; este programa solo lee y valida
+ las opciones.
  ============================================================================
  */
 
 #include <iostream>
+#include <cstdio>
 #include <cstdlib>
 #include <ctime>
 #include <mpi.h>
-#include <cmath>
+#include <string>
+
+#include "distribuida_mxv.h"
+#include "fichero_matriz.h"
+#include "perfil_mxv.h"
+#include "programa_mxv.h"
+#include "utilidades_mxv.h"
+#include "verificacion_mxv.h"
 
 using namespace std;
 
@@ -24,309 +42,130 @@ int main(int argc, char * argv[]) {
 
     int numeroProcesadores,
             idProceso;
-    long    *A, // Matriz a multiplicar
-            *x, // Vector que vamos a multiplicar
-            *y, // Vector donde almacenamos el resultado
-            *subMatriz, // La submatriz que almacena localmente un proceso
-            *comprueba; // Guarda el resultado final (calculado secuencialmente), su valor
-                        // debe ser igual al de 'y'
-
-    long compruebaSum = 0; // Para mostrar resultado de comprobación para valores de n > 24
-    long ySum = 0; // Para mostrar resultado de comprobación para valores de n > 24
 
-    double tInicio, // Tiempo en el que comienza la ejecucion
-            tFin, // Tiempo en el que acaba la ejecucion
-            tSecuencialIni,
-            tSecuencialFin,
-            tSecuencial;
-
-    int n;
-    if (argc != 2) {
-        if (idProceso == 0) {
-            cout << "Uso: Pasar como parámetro dimensión de la matriz n" << endl;
-        }
-        return (0);
-    }
-    else {
-        n = atoi(argv[1]);
-    }
-
-    MPI_Init(&argc, &argv);
+    // Solo el hilo principal de cada proceso llama a MPI
+    int nivelHilos;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &nivelHilos);
     MPI_Comm_size(MPI_COMM_WORLD, &numeroProcesadores);
     MPI_Comm_rank(MPI_COMM_WORLD, &idProceso);
 
-    int raizP = sqrt(numeroProcesadores);
-
-    if (n % raizP != 0) {
-        if (idProceso == 0) {
-            cout << "Uso: n debe ser multiplo de sqrt(numeroProcesadores)" << endl;
+    // Submatrices de la malla de procesos filasMalla x columnasMalla
+    ConfiguracionMxv configuracion;
+    OpcionesPrograma opciones;
+    configuracion.distribucion = DISTRIBUCION_BLOQUES;
+    configuracion.semilla = time(0);
+    bool generacionLocal = false, // Cada proceso genera su submatriz, sin matriz completa en el proceso 0
+            proyeccion = false; // Usar la submatriz proyectada en memoria (mmap) en lugar de leerla
+    bool argumentosValidos = (argc >= 2), almacenIndicado = false;
+    for (int i = 1; i < argc && argumentosValidos; i++) {
+        if (i == 1 && argv[i][0] != '-') {
+            configuracion.n = atol(argv[i]);
+        } else if (string(argv[i]) == "--file" && i + 1 < argc) {
+            configuracion.fichero = argv[++i];
+        } else if (string(argv[i]) == "--mmap") {
+            proyeccion = true;
+        } else if (string(argv[i]) == "--stream" && i + 1 < argc) {
+            configuracion.filasPanel = atol(argv[++i]);
+            argumentosValidos = configuracion.filasPanel > 0;
+        } else if (string(argv[i]) == "--iterations" && i + 1 < argc) {
+            opciones.iteraciones = atoi(argv[++i]);
+        } else if (string(argv[i]) == "--tolerance" && i + 1 < argc) {
+            opciones.tolerancia = atof(argv[++i]);
+        } else if (string(argv[i]) == "--rhs" && i + 1 < argc) {
+            configuracion.k = atoi(argv[++i]);
+        } else if (string(argv[i]) == "--seed" && i + 1 < argc) {
+            configuracion.semilla = strtoull(argv[++i], NULL, 10);
+        } else if (string(argv[i]) == "--grid" && i + 1 < argc) {
+            argumentosValidos = sscanf(argv[++i], "%dx%d", &configuracion.filasMalla, &configuracion.columnasMalla) == 2
+                    && configuracion.filasMalla > 0 && configuracion.columnasMalla > 0;
+        } else if (string(argv[i]) == "--threads" && i + 1 < argc) {
+            opciones.hilos = atoi(argv[++i]);
+            argumentosValidos = opciones.hilos > 0;
+        } else if (string(argv[i]) == "--warmup" && i + 1 < argc) {
+            opciones.calentamiento = atoi(argv[++i]);
+        } else if (string(argv[i]) == "--repeat" && i + 1 < argc) {
+            opciones.repeticiones = atoi(argv[++i]);
+        } else if (string(argv[i]) == "--csv" && i + 1 < argc) {
+            opciones.csv = argv[++i];
+        } else if (string(argv[i]) == "--json" && i + 1 < argc) {
+            opciones.json = argv[++i];
+        } else if (string(argv[i]) == "--verify" && i + 1 < argc) {
+            argumentosValidos = verificacionDesdeNombre(argv[++i], opciones.verificacion);
+        } else if (string(argv[i]) == "--abft") {
+            configuracion.abft = true;
+        } else if (string(argv[i]) == "--distributed-y") {
+            configuracion.yRepartido = true;
+        } else if (string(argv[i]) == "--persistent") {
+            configuracion.persistentes = true;
+        } else if (string(argv[i]) == "--topology") {
+            configuracion.topologia = true;
+        } else if (string(argv[i]) == "--profile") {
+            opciones.perfil = true;
+        } else if (string(argv[i]) == "--trace" && i + 1 < argc) {
+            opciones.traza = argv[++i];
+            opciones.perfil = true;
+        } else if (string(argv[i]) == "--generate-local") {
+            generacionLocal = true;
+        } else if (string(argv[i]) == "--dtype" && i + 1 < argc) {
+            argumentosValidos = tipoDatoDesdeNombre(argv[++i], opciones.tipo);
+        } else if (string(argv[i]) == "--storage" && i + 1 < argc) {
+            argumentosValidos = almacenDesdeNombre(argv[++i], opciones.almacen);
+            almacenIndicado = true;
+        } else if (string(argv[i]) == "--compress") {
+            configuracion.comprimir = true;
+        } else {
+            argumentosValidos = false;
         }
-        MPI_Finalize();
-        return (0);
     }
-
-    /* ---------------------------------------------------------------------------------------------------------------------------
-        Inicialización de variables
-    --------------------------------------------------------------------------------------------------------------------------- */
-    int tam = n / raizP; // Dimensión de las submatrices
-    int nElem = tam * tam; // Numero de elementos que procesa cada procesador
-    int filaP, columnaP; // indice de cada proceso dentro de la submatriz
-    A = new long [nElem]; // Reservamos los elementos de cada proceso
-    x = new long [n]; // El vector sera del mismo tamaño que una fila de la matriz
-    y = new long [n]; // Reservamos especio para el resultado
-    /* ---------------------------------------------------------------------------------------------------------------------------
-        (FIN) Inicialización de variables
-    --------------------------------------------------------------------------------------------------------------------------- */
-
-    MPI_Datatype MPI_BLOQUE; // Tipo de dato para reordenar la matriz y poder enviar submatrices como elementos consecutivos
-
-    // Solo el proceso 0 ejecuta el siguiente bloque
-    if (idProceso == 0) {
-        long *auxiliar = new long[n * n];
-
-        // Rellenamos 'auxiliar' y 'x' con valores aleatorios
-        cout << "Inicio carga de datos........" << endl;
-        srand(time(0));
-        for (unsigned int i = 0; i < n; i++) {
-            for (unsigned int j = 0; j < n; j++) {
-                auxiliar[i * n + j] = rand() % 1000;
-            }
-            x[i] = rand() % 100;
-        }
-        cout << "........Fin carga de datos" << endl;
-
-        if (n < 24) {
-            cout << "La matriz y el vector generados son " << endl;
-            for (unsigned int i = 0; i < n; i++) {
-                for (unsigned int j = 0; j < n; j++) {
-                    if (j == 0) cout << "[";
-                    cout << auxiliar[i * n + j];
-                    if (j == n - 1) cout << "]";
-                    else cout << "  ";
-                }
-                cout << "\t  [" << x[i] << "]" << endl;
-            }
-            cout << "\n";
-        }
-
-        // Reservamos espacio para la comprobacion
-        comprueba = new long [n];
-        // Realizamos el algoritmo secuencial para comprobar
-        cout << "Inicio algoritmo secuencial........" << endl;
-	    tSecuencialIni = clock();
-        // Lo calculamos de forma secuencial
-        for (unsigned int i = 0; i < n; i++) {
-            comprueba[i] = 0;
-            for (unsigned int j = 0; j < n; j++) {
-                comprueba[i] += auxiliar[i * n + j] * x[j];
-            }
-        }
-	    tSecuencialFin = clock();
-        cout << "........Fin algoritmo secuencial" << endl;
-        tSecuencial = (tSecuencialFin - tSecuencialIni) / CLOCKS_PER_SEC;
-        // Calculamos un solo valor para mostrar por pantalla si n grande
-        for (unsigned int i = 0; i < n; i++) {
-            compruebaSum += comprueba[i];
-        }
-
-        /* ---------------------------------------------------------------------------------------------------------------------------
-            Reordenación de matriz auxiliar en A
-            Para poder hacer scatter de la matriz A y que cada proceso reciba su parte
-        --------------------------------------------------------------------------------------------------------------------------- */
-        // Defino el tipo bloque cuadrado
-        MPI_Type_vector (tam, tam, n, MPI_LONG, &MPI_BLOQUE);
-        MPI_Type_commit (&MPI_BLOQUE);
-
-        A = new long [n * n];
-
-        cout << "NumeroP: " << numeroProcesadores << ", raizP: " << raizP << ", tam: " << tam << ", n: " << n << ", nElem: " << nElem << endl;
-        
-        int comienzo, posicion;
-        for (int i = 0, posicion = 0; i < numeroProcesadores; i++) {
-            // Calculo la posicion de comienzo de cada submatriz
-            filaP = i / raizP;
-            columnaP = i % raizP;
-            comienzo = (columnaP * tam) + (filaP * tam * tam * raizP);
-            MPI_Pack(&auxiliar[comienzo], 1, MPI_BLOQUE, A, sizeof(long) * n * n, &posicion, MPI_COMM_WORLD);
-        }
-        // Libero memoria de matriz auxiliar
-        delete [] auxiliar;
-        MPI_Type_free (&MPI_BLOQUE);
-        if (n < 24) {
-            cout << "La matriz reordenada es " << endl;
-            for (unsigned int i = 0; i < n; i++) {
-                for (unsigned int j = 0; j < n; j++) {
-                    if (j == 0) cout << "[";
-                    cout << A[i * n + j];
-                    if (j == n - 1) cout << "]";
-                    else cout << "  ";
-                }
-                cout << endl;
-            }
-            cout << "\n";
-        }
-        /* ---------------------------------------------------------------------------------------------------------------------------
-            (FIN) Reordenación de matriz auxiliar en A
-        --------------------------------------------------------------------------------------------------------------------------- */
-
-    } // Termina el trozo de codigo que ejecuta solo 0
-
-    // Reservamos espacio para la fila local de cada proceso
-    subMatriz = new long [nElem];
-
-    /* ---------------------------------------------------------------------------------------------------------------------------
-        Creamos los comunicadores necesarios a partir de COMM_WORLD
-        - filas: reune a los elementos de una misma fila, ordenados de izquierda a derecha
-            Usaremos este comunicador para recibir y reducir los subvalores de "y" en el proceso de 
-            filas que ocupa la posición diagonal en COMM_WORLD, y desde ahí hacer gather en proceso 0
-        - columnas: reune a los elementos de una misma columna, ordenados de arriba a abajo
-            Usaremos este comunicador para recibir la parte de x que necesitan todos los procesos de 
-            una misma columna (Broadcast) desde el proceso de la columna que ocupa la posición diagonal 
-            en COMM_WORLD
-        - diagonal: usamos este comunicador para hacer scatter del vector x entre los procesos de cada columna
-            y posteriormente hacer gather de los resultados de cada fila
-    --------------------------------------------------------------------------------------------------------------------------- */
-    MPI_Comm filas, columnas, diagonal; // nuevos comunicadores
-
-    filaP = idProceso / raizP;
-    MPI_Comm_split(MPI_COMM_WORLD, // a partir del comunicador global.
-        filaP, // los de la misma fila entraran en el mismo comunicador
-        idProceso, // indica el orden de asignacion de rango dentro de los nuevos comunicadores
-        &filas); // Referencia al nuevo comunicador creado.
-
-    columnaP = idProceso % raizP;
-    MPI_Comm_split(MPI_COMM_WORLD, columnaP, idProceso, &columnas);
-
-    int inDiagonal = MPI_UNDEFINED;
-    if (filaP == columnaP) {
-        inDiagonal = 1;
+    const bool conFichero = !configuracion.fichero.empty();
+    if (!almacenIndicado) {
+        opciones.almacen = opciones.tipo;
+    } else if (conFichero || !almacenValido(opciones.almacen, opciones.tipo)) {
+        argumentosValidos = false; // El fichero fija el tipo de la matriz
     }
-    MPI_Comm_split(MPI_COMM_WORLD, inDiagonal, idProceso, &diagonal);
-    /* ---------------------------------------------------------------------------------------------------------------------------
-        (FIN) Creamos los comunicadores necesarios a partir de COMM_WORLD
-    --------------------------------------------------------------------------------------------------------------------------- */
-
-    // Repartimos datos entre los procesos: ---------------------------------------------------
-    MPI_Scatter(A, // Matriz que vamos a compartir
-        nElem, // Numero de datos a compartir
-        MPI_LONG, // Tipo de dato a enviar
-        subMatriz, // Vector en el que almacenar los datos
-        nElem, // Numero de datos a compartir
-        MPI_LONG, // Tipo de dato a recibir
-        0, // Proceso raiz que envia los datos
-        MPI_COMM_WORLD); // Comunicador utilizado (En este caso, el global)
-
-    if (inDiagonal == 1) {
-        MPI_Scatter(x, tam, MPI_LONG, x, tam, MPI_LONG, 0, diagonal); // A cada columna de procesos un trozo de x
+    if (configuracion.comprimir && (generacionLocal || conFichero
+            || opciones.almacen == TIPO_FLOAT || opciones.almacen == TIPO_DOUBLE)) {
+        argumentosValidos = false; // Solo se comprime el reparto de A desde el proceso 0, y solo con enteros
     }
-
-    MPI_Bcast(x, tam, MPI_LONG, columnaP, columnas); // Elemento en la diagonal reparte al resto de su columna el trozo de vector x recibido
-
-    if (n < 24) {
-            cout << "Proceso" << idProceso << ", x = [";
-        for (int i = 0; i < tam; i++) {
-            cout << " " << x[i] << " ";
-        }
-        cout << " ]" << endl;
+    if (configuracion.filasPanel > 0 && (!conFichero || proyeccion)) {
+        argumentosValidos = false; // Los paneles se leen del fichero de --file
     }
-    // ----------------------------------------------------------------------------------------
-
-    // Hacemos una barrera para asegurar que todas los procesos comiencen la ejecucion
-    // a la vez, para tener mejor control del tiempo empleado
-    MPI_Barrier(MPI_COMM_WORLD);
-    // Inicio de medicion de tiempo
-    tInicio = MPI_Wtime();
-
-    long *subFinal = new long [tam];
-
-    for (unsigned int i = 0; i < tam; i++) {
-        subFinal[i] = 0;
-        for (unsigned int j = 0; j < tam; j++) {
-            // cout << "proc=" << idProceso << ", i=" << i << ", j=" << j << ", subfinal[" << i << "] += " << subMatriz[(i * tam) + j] << " * " << x[j] << endl;
-            subFinal[i] += subMatriz[(i * tam) + j] * x[j];
+    if (argumentosValidos && conFichero) {
+        // El tamaño y el tipo de dato los fija el fichero
+        CabeceraMatriz cabecera;
+        argumentosValidos = leeCabeceraMPI(configuracion.fichero.c_str(), cabecera, MPI_COMM_WORLD)
+                && cabecera.disposicion == DISPOSICION_FILAS && cabecera.filas == cabecera.columnas;
+        configuracion.n = cabecera.filas;
+        opciones.tipo = (TipoDato) cabecera.tipo;
+        opciones.almacen = opciones.tipo;
+        if (!argumentosValidos && idProceso == 0) {
+            cout << "El fichero " << configuracion.fichero << " no existe, no contiene una matriz cuadrada densa o no tiene el tamaño que indica su cabecera" << endl;
         }
     }
-
-    // Otra barrera para asegurar que todas ejecuten el siguiente trozo de c�digo lo
-    // mas proximamente posible
-    MPI_Barrier(MPI_COMM_WORLD);
-    // fin de medicion de tiempo
-    tFin = MPI_Wtime();
-
-    // int filasSize, filasRank;
-    // MPI_Comm_size(filas, &filasSize);
-    // MPI_Comm_rank(filas, &filasRank);
-    // cout << "proceso: " << idProceso << ", en fila: " << filasRank << " de " << filasSize << " reduce en " << filaP << endl;
-
-    if (n < 24) {
-        cout << "ANTES DE REDUCIR: Proceso " << idProceso << ", subVector = ["; 
-        for (int i = 0; i < tam; i++) {
-            cout << " " << subFinal[i] << " ";
-        }
-        cout << "]" << endl;
+    if (argumentosValidos && configuracion.filasMalla == 0) {
+        // Malla lo mas cuadrada posible para el numero de procesos
+        int dimensiones[2] = {0, 0};
+        MPI_Dims_create(numeroProcesadores, 2, dimensiones);
+        configuracion.filasMalla = dimensiones[0];
+        configuracion.columnasMalla = dimensiones[1];
     }
-
-    MPI_Reduce(&subFinal[0], // Valor local de datos
-                y,  // Dato sobre el que vamos a reducir el resto
-                tam,	  // Numero de datos que vamos a reducir
-                MPI_LONG,  // Tipo de dato que vamos a reducir
-                MPI_SUM,  // Operacion que aplicaremos
-                filaP, // proceso que va a recibir el dato reducido (elemento en la diagonal)
-                filas); // Canal de comunicacion (Filas)
-
-    if (inDiagonal == 1 && n < 24) {
-        cout << "Proceso " << idProceso << ", vector reducido = ["; 
-        for (int i = 0; i < tam; i++) {
-            cout << " " << y[i] << " ";
+    if (!argumentosValidos || configuracion.n <= 0 || opciones.iteraciones < 1 || configuracion.k < 1
+            || configuracion.filasMalla * configuracion.columnasMalla != numeroProcesadores
+            || opciones.calentamiento < 0 || opciones.repeticiones < 1) {
+        if (idProceso == 0) {
+            cout << "Uso: Pasar como parámetro dimensión de la matriz n [--iterations K] [--tolerance eps] [--rhs k] [--dtype int32|int64|float|double] [--storage int16|int32|float] [--compress] [--seed S] [--generate-local] [--threads T] [--file fichero [--mmap | --stream F]] [--grid RxC, con R * C = numero de procesos] [--warmup W] [--repeat R] [--csv fichero] [--json fichero] [--verify full|freivalds|none] [--abft] [--profile] [--trace fichero] [--distributed-y] [--persistent] [--topology]" << endl;
         }
-        cout << "]" << endl;
+        MPI_Finalize();
+        return (0);
     }
-
-    if (inDiagonal == 1) {
-        MPI_Gather(y, // Dato que envia cada proceso
-                tam, // Numero de elementos que se envian
-                MPI_LONG, // Tipo del dato que se envia
-                y, // Vector en el que se recolectan los datos
-                tam, // Numero de datos que se esperan recibir por cada proceso
-                MPI_LONG, // Tipo del dato que se recibira
-                0, // proceso que va a recibir los datos
-                diagonal); // Canal de comunicacion Diagonal
+    if (conFichero) {
+        configuracion.carga = proyeccion ? CARGA_PROYECCION : configuracion.filasPanel > 0 ? CARGA_FLUJO : CARGA_FICHERO;
+    } else {
+        configuracion.carga = generacionLocal ? CARGA_GENERADA : CARGA_RAIZ;
     }
 
-    MPI_Finalize();
-
-    if (idProceso == 0) {
-
-        unsigned int errores = 0;
-
-        cout << "El resultado obtenido y el esperado son:" << endl;
-        for (unsigned int i = 0; i < n; i++) {
-            ySum += y[i];
-            if (n < 24) {
-                cout << "\t" << y[i] << "\t|\t" << comprueba[i] << endl;
-            }
-            if (comprueba[i] != y[i])
-                errores++;
-        }
-        cout << "\tSUMA DE VECTORES: " << ySum << "\t|\t" << compruebaSum << endl;
-
-        delete [] y;
-        delete [] comprueba;
-
-        if (errores) {
-            cout << "Hubo " << errores << " errores." << endl;
-        } else {
-            cout << "No hubo errores" << endl;
-            cout << "El tiempo paralelo ha sido " << tFin - tInicio << " segundos." << endl;
-            cout << "El tiempo secuencial ha sido " << tSecuencial << " segundos." << endl;
-            cout << "La ganancia ha sido " << tSecuencial/(tFin - tInicio) << endl;
-        }
-
-    }
+    ejecutaPrograma(configuracion, opciones);
 
-    delete [] x;
-    delete [] A;
-    delete [] subMatriz;
+    MPI_Finalize();
 
 }
-
@@ -0,0 +1,326 @@
+/*
+ ============================================================================
+ Name        : colectivas_mxv.h
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Operaciones colectivas con cuentas y desplazamientos de 64 bits
+    y colectivas persistentes para la biblioteca de distribuida_mxv.h.
+
+ Las cuentas de MPI son int: con n > 46340 una matriz de n x n (o la submatriz
+ de un proceso) tiene mas de 2^31 elementos. Casi siempre basta con contar en
+ unidades mayores (filas de n elementos con MPI_Type_contiguous, como hacen los
+ programas), pero no en el reparto de submatrices desde A, cuyos
+ desplazamientos son posiciones de elementos, ni en MPI_Reduce, que con las
+ operaciones predefinidas solo admite tipos basicos. Para esos casos estan
+ estas funciones: con MPI-4 llaman a las variantes _c de cuenta grande y con
+ versiones anteriores trocean la operacion en partes de como mucho TROZO_MPI
+ elementos.
+
+ Las colectivas persistentes (ColectivaPersistente) son para las que se
+ repiten en cada iteracion con los mismos buffers, como la difusion de x y la
+ reduccion de y: se preparan una vez y en cada iteracion solo se inician y se
+ esperan, sin volver a elegir el algoritmo ni a crear tipos. Con MPI-4 son
+ MPI_Bcast_init y MPI_Reduce_init; con versiones anteriores, un arbol binomial
+ de peticiones persistentes punto a punto (MPI_Send_init y MPI_Recv_init).
+ Con submatrices pequeñas el coste de cada iteracion es sobre todo latencia,
+ que es lo que se ahorra. En el perfil (perfil_mxv.h) su tiempo no aparece
+ como MPI_Bcast o MPI_Reduce sino en MPI_Wait(all).
+ ============================================================================
+ */
+
+#ifndef COLECTIVAS_MXV_H
+#define COLECTIVAS_MXV_H
+
+#include <algorithm>
+#include <climits>
+#include <mpi.h>
+#include <vector>
+
+const long TROZO_MPI = 1L << 30; // Elementos por trozo cuando no hay variantes _c
+const int ETIQUETA_REPARTO = 4096; // Mensajes punto a punto de scattervGrande
+const int ETIQUETA_DIFUSION = 4097; // Mensajes de las difusiones persistentes sin MPI-4
+const int ETIQUETA_REDUCCION = 4098; // Mensajes de las reducciones persistentes sin MPI-4
+const int ETIQUETA_NODO = 4099; // Mensajes punto a punto de recogeNodos (nodo_mxv.h)
+const int ETIQUETA_SONDA = 4100; // Ping-pong de las sondas de red de autoajuste_mxv.h
+
+/*
+ Tipo (ya confirmado) de 'cuenta' elementos consecutivos de 'tipo', para enviar
+ o recibir con cuenta 1 cualquier numero de elementos: trozos de TROZO_MPI
+ elementos y un resto. Hay que liberarlo con MPI_Type_free.
+ */
+inline MPI_Datatype tipoGrande(long cuenta, MPI_Datatype tipo) {
+    MPI_Datatype resultado;
+    if (cuenta <= TROZO_MPI) {
+        MPI_Type_contiguous(cuenta, tipo, &resultado);
+    } else {
+        MPI_Aint limite, extension;
+        MPI_Type_get_extent(tipo, &limite, &extension);
+        MPI_Datatype trozo, trozos, resto;
+        MPI_Type_contiguous(TROZO_MPI, tipo, &trozo);
+        MPI_Type_contiguous(cuenta / TROZO_MPI, trozo, &trozos);
+        MPI_Type_contiguous(cuenta % TROZO_MPI, tipo, &resto);
+        int longitudes[2] = {1, 1};
+        MPI_Aint posiciones[2] = {0, (MPI_Aint) (cuenta / TROZO_MPI * TROZO_MPI) * extension};
+        MPI_Datatype tipos[2] = {trozos, resto};
+        MPI_Type_create_struct(2, longitudes, posiciones, tipos, &resultado);
+        MPI_Type_free(&trozo);
+        MPI_Type_free(&trozos);
+        MPI_Type_free(&resto);
+    }
+    MPI_Type_commit(&resultado);
+    return resultado;
+}
+
+/*
+ MPI_Scatterv con cuentas y desplazamientos (en extensiones de 'tipoEnvio') de
+ 64 bits; 'cuentas' y 'despl' solo hacen falta en la raiz. Sin MPI-4, si todo
+ cabe en un int se usa MPI_Scatterv y si no la raiz envia cada trozo punto a
+ punto, con un tipoGrande a cada lado.
+ */
+inline void scattervGrande(const void *envio, const long *cuentas, const long *despl, MPI_Datatype tipoEnvio,
+        void *recepcion, long cuenta, MPI_Datatype tipoRecepcion, int raiz, MPI_Comm comunicador) {
+    int id, P;
+    MPI_Comm_rank(comunicador, &id);
+    MPI_Comm_size(comunicador, &P);
+#if MPI_VERSION >= 4
+    std::vector<MPI_Count> cuentasC(P);
+    std::vector<MPI_Aint> desplC(P);
+    if (id == raiz) {
+        std::copy(cuentas, cuentas + P, cuentasC.begin());
+        std::copy(despl, despl + P, desplC.begin());
+    }
+    MPI_Scatterv_c(envio, &cuentasC[0], &desplC[0], tipoEnvio, recepcion, cuenta, tipoRecepcion, raiz, comunicador);
+#else
+    // La raiz conoce todas las cuentas, asi que decide por todos
+    int grande = 0;
+    std::vector<int> cuentasInt(P), desplInt(P);
+    if (id == raiz) {
+        for (int r = 0; r < P; r++) {
+            grande = grande || cuentas[r] > INT_MAX || despl[r] > INT_MAX;
+            cuentasInt[r] = cuentas[r];
+            desplInt[r] = despl[r];
+        }
+    }
+    MPI_Bcast(&grande, 1, MPI_INT, raiz, comunicador);
+    if (!grande) {
+        MPI_Scatterv(envio, &cuentasInt[0], &desplInt[0], tipoEnvio, recepcion, cuenta, tipoRecepcion, raiz, comunicador);
+        return;
+    }
+    if (id != raiz) {
+        if (cuenta > 0) {
+            MPI_Datatype tipo = tipoGrande(cuenta, tipoRecepcion);
+            MPI_Recv(recepcion, 1, tipo, raiz, ETIQUETA_REPARTO, comunicador, MPI_STATUS_IGNORE);
+            MPI_Type_free(&tipo);
+        }
+        return;
+    }
+    MPI_Aint limite, extension;
+    MPI_Type_get_extent(tipoEnvio, &limite, &extension);
+    std::vector<MPI_Request> peticiones;
+    std::vector<MPI_Datatype> tipos;
+    for (int r = 0; r < P; r++) {
+        if (cuentas[r] == 0 || (r == raiz && recepcion == MPI_IN_PLACE)) continue;
+        tipos.push_back(tipoGrande(cuentas[r], tipoEnvio));
+        peticiones.push_back(MPI_REQUEST_NULL);
+        MPI_Isend((const char *) envio + despl[r] * extension, 1, tipos.back(), r, ETIQUETA_REPARTO, comunicador, &peticiones.back());
+    }
+    if (cuenta > 0 && recepcion != MPI_IN_PLACE) {
+        MPI_Datatype tipo = tipoGrande(cuenta, tipoRecepcion);
+        MPI_Recv(recepcion, 1, tipo, raiz, ETIQUETA_REPARTO, comunicador, MPI_STATUS_IGNORE);
+        MPI_Type_free(&tipo);
+    }
+    if (!peticiones.empty()) {
+        MPI_Waitall(peticiones.size(), &peticiones[0], MPI_STATUSES_IGNORE);
+    }
+    for (size_t t = 0; t < tipos.size(); t++) {
+        MPI_Type_free(&tipos[t]);
+    }
+#endif
+}
+
+/*
+ MPI_Reduce de 'cuenta' elementos de un tipo basico, con cuenta de 64 bits. Sin
+ MPI-4 se reduce por trozos de TROZO_MPI elementos.
+ */
+inline void reduceGrande(const void *envio, void *recepcion, long cuenta, MPI_Datatype tipo, MPI_Op operacion,
+        int raiz, MPI_Comm comunicador) {
+#if MPI_VERSION >= 4
+    MPI_Reduce_c(envio, recepcion, cuenta, tipo, operacion, raiz, comunicador);
+#else
+    MPI_Aint limite, extension;
+    MPI_Type_get_extent(tipo, &limite, &extension);
+    for (long hecho = 0; hecho < cuenta; hecho += TROZO_MPI) {
+        const void *envioTrozo = (envio == MPI_IN_PLACE) ? MPI_IN_PLACE : (const char *) envio + hecho * extension;
+        void *recepcionTrozo = (recepcion == NULL) ? NULL : (char *) recepcion + hecho * extension;
+        MPI_Reduce(envioTrozo, recepcionTrozo, std::min(TROZO_MPI, cuenta - hecho), tipo, operacion, raiz, comunicador);
+    }
+#endif
+}
+
+/*
+ Difusion o reduccion persistente. Sin MPI-4, cada proceso recibe del padre y
+ envia a sus hijos en un arbol binomial con raiz en 'raiz' (difusion), o
+ recibe de sus hijos, acumula con MPI_Reduce_local y envia al padre
+ (reduccion).
+ */
+struct ColectivaPersistente {
+    ColectivaPersistente() : reduccion(false), tipo(MPI_DATATYPE_NULL), tipoBasico(MPI_DATATYPE_NULL), operacion(MPI_OP_NULL),
+            cuenta(0), envio(NULL), acumulado(NULL), recibidos(NULL), propio(NULL) {}
+
+    bool reduccion;
+    std::vector<MPI_Request> recepciones; // Del padre (difusion) o de los hijos (reduccion)
+    std::vector<MPI_Request> envios; // A los hijos (difusion) o al padre (reduccion); con MPI-4, la colectiva
+    MPI_Datatype tipo; // Mensaje completo (tipoGrande)
+    MPI_Datatype tipoBasico; // Reduccion: tipo y operacion de MPI_Reduce_local
+    MPI_Op operacion;
+    long cuenta;
+    const void *envio; // Reduccion: datos de este proceso
+    void *acumulado; // Reduccion: suma de su subarbol (en la raiz, el resultado)
+    char *recibidos; // Reduccion: un mensaje por hijo
+    char *propio; // Reduccion: 'acumulado' reservado aqui, en los procesos intermedios
+};
+
+/*
+ Proceso padre e hijos de 'id' en el arbol binomial de 'P' procesos con raiz en
+ 'raiz' (el padre de la raiz es -1). Los hijos van del subarbol mayor al menor.
+ */
+inline int arbolBinomial(int id, int P, int raiz, std::vector<int> &hijos) {
+    int relativo = (id - raiz + P) % P, padre = -1, mascara = 1;
+    while (mascara < P) {
+        if (relativo & mascara) {
+            padre = (relativo - mascara + raiz) % P;
+            break;
+        }
+        mascara <<= 1;
+    }
+    hijos.clear();
+    for (mascara >>= 1; mascara > 0; mascara >>= 1) {
+        if (relativo + mascara < P) {
+            hijos.push_back((relativo + mascara + raiz) % P);
+        }
+    }
+    return padre;
+}
+
+// MPI_Bcast persistente de 'cuenta' elementos de 'tipo' en 'buffer'
+inline void preparaBcastPersistente(void *buffer, long cuenta, MPI_Datatype tipo, int raiz, MPI_Comm comunicador,
+        ColectivaPersistente &colectiva) {
+    colectiva.reduccion = false;
+    colectiva.cuenta = cuenta;
+#if MPI_VERSION >= 4
+    colectiva.envios.assign(1, MPI_REQUEST_NULL);
+    MPI_Bcast_init_c(buffer, cuenta, tipo, raiz, comunicador, MPI_INFO_NULL, &colectiva.envios[0]);
+#else
+    int id, P;
+    MPI_Comm_rank(comunicador, &id);
+    MPI_Comm_size(comunicador, &P);
+    std::vector<int> hijos;
+    int padre = arbolBinomial(id, P, raiz, hijos);
+    colectiva.tipo = tipoGrande(cuenta, tipo);
+    if (padre >= 0) {
+        colectiva.recepciones.assign(1, MPI_REQUEST_NULL);
+        MPI_Recv_init(buffer, 1, colectiva.tipo, padre, ETIQUETA_DIFUSION, comunicador, &colectiva.recepciones[0]);
+    }
+    colectiva.envios.assign(hijos.size(), MPI_REQUEST_NULL);
+    for (size_t h = 0; h < hijos.size(); h++) {
+        MPI_Send_init(buffer, 1, colectiva.tipo, hijos[h], ETIQUETA_DIFUSION, comunicador, &colectiva.envios[h]);
+    }
+#endif
+}
+
+/*
+ MPI_Reduce persistente de 'cuenta' elementos de un tipo basico, de 'envio' a
+ 'recepcion' (solo en la raiz). 'operacion' debe ser conmutativa.
+ */
+inline void preparaReducePersistente(const void *envio, void *recepcion, long cuenta, MPI_Datatype tipo, MPI_Op operacion,
+        int raiz, MPI_Comm comunicador, ColectivaPersistente &colectiva) {
+    colectiva.reduccion = true;
+    colectiva.cuenta = cuenta;
+#if MPI_VERSION >= 4
+    colectiva.envios.assign(1, MPI_REQUEST_NULL);
+    MPI_Reduce_init_c(envio, recepcion, cuenta, tipo, operacion, raiz, comunicador, MPI_INFO_NULL, &colectiva.envios[0]);
+#else
+    int id, P;
+    MPI_Comm_rank(comunicador, &id);
+    MPI_Comm_size(comunicador, &P);
+    std::vector<int> hijos;
+    int padre = arbolBinomial(id, P, raiz, hijos);
+    MPI_Aint limite, extension;
+    MPI_Type_get_extent(tipo, &limite, &extension);
+    colectiva.tipo = tipoGrande(cuenta, tipo);
+    colectiva.tipoBasico = tipo;
+    colectiva.operacion = operacion;
+    colectiva.envio = envio;
+    // Las hojas envian directamente sus datos; el resto acumula antes los de sus hijos
+    if (padre < 0) {
+        colectiva.acumulado = recepcion;
+    } else if (!hijos.empty()) {
+        colectiva.propio = new char[cuenta * extension];
+        colectiva.acumulado = colectiva.propio;
+    }
+    if (!hijos.empty()) {
+        colectiva.recibidos = new char[hijos.size() * cuenta * extension];
+    }
+    colectiva.recepciones.assign(hijos.size(), MPI_REQUEST_NULL);
+    for (size_t h = 0; h < hijos.size(); h++) {
+        MPI_Recv_init(colectiva.recibidos + h * cuenta * extension, 1, colectiva.tipo, hijos[h], ETIQUETA_REDUCCION, comunicador,
+                &colectiva.recepciones[h]);
+    }
+    if (padre >= 0) {
+        colectiva.envios.assign(1, MPI_REQUEST_NULL);
+        MPI_Send_init(hijos.empty() ? envio : colectiva.acumulado, 1, colectiva.tipo, padre, ETIQUETA_REDUCCION, comunicador,
+                &colectiva.envios[0]);
+    }
+#endif
+}
+
+// Una repeticion de la colectiva, bloqueante como la operacion original
+inline void ejecutaColectiva(ColectivaPersistente &colectiva) {
+    if (!colectiva.recepciones.empty()) {
+        MPI_Startall(colectiva.recepciones.size(), &colectiva.recepciones[0]);
+    }
+    if (colectiva.reduccion && colectiva.acumulado != NULL) {
+        // Mientras llegan los datos de los hijos se copian los propios
+        MPI_Aint limite, extension;
+        MPI_Type_get_extent(colectiva.tipoBasico, &limite, &extension);
+        std::copy((const char *) colectiva.envio, (const char *) colectiva.envio + colectiva.cuenta * extension, (char *) colectiva.acumulado);
+    }
+    if (!colectiva.recepciones.empty()) {
+        MPI_Waitall(colectiva.recepciones.size(), &colectiva.recepciones[0], MPI_STATUSES_IGNORE);
+    }
+    if (colectiva.reduccion && colectiva.recibidos != NULL) {
+        MPI_Aint limite, extension;
+        MPI_Type_get_extent(colectiva.tipoBasico, &limite, &extension);
+        for (size_t h = 0; h < colectiva.recepciones.size(); h++) {
+            const char *hijo = colectiva.recibidos + h * colectiva.cuenta * extension;
+            for (long hecho = 0; hecho < colectiva.cuenta; hecho += TROZO_MPI) {
+                MPI_Reduce_local(hijo + hecho * extension, (char *) colectiva.acumulado + hecho * extension,
+                        std::min(TROZO_MPI, colectiva.cuenta - hecho), colectiva.tipoBasico, colectiva.operacion);
+            }
+        }
+    }
+    if (!colectiva.envios.empty()) {
+        MPI_Startall(colectiva.envios.size(), &colectiva.envios[0]);
+        MPI_Waitall(colectiva.envios.size(), &colectiva.envios[0], MPI_STATUSES_IGNORE);
+    }
+}
+
+inline void liberaColectiva(ColectivaPersistente &colectiva) {
+    for (size_t r = 0; r < colectiva.recepciones.size(); r++) {
+        MPI_Request_free(&colectiva.recepciones[r]);
+    }
+    for (size_t e = 0; e < colectiva.envios.size(); e++) {
+        MPI_Request_free(&colectiva.envios[e]);
+    }
+    colectiva.recepciones.clear();
+    colectiva.envios.clear();
+    if (colectiva.tipo != MPI_DATATYPE_NULL) {
+        MPI_Type_free(&colectiva.tipo);
+    }
+    delete [] colectiva.recibidos;
+    delete [] colectiva.propio;
+    colectiva = ColectivaPersistente();
+}
+
+#endif
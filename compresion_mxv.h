@@ -0,0 +1,140 @@
+/*
+ ============================================================================
+ Name        : compresion_mxv.h
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Compresion ligera de los bloques de A que se envian en el
+    reparto (--compress) de matriz_x_vector.cpp y
+    bidimensional_matriz_x_vector.cpp.
+
+ Con x residente y muchas iteraciones, el reparto de A es la unica
+ comunicacion de O(n^2) y esta limitada por el ancho de banda de la red. Los
+ elementos de un bloque suelen ocupar muchos menos bits que su tipo (la matriz
+ generada tiene valores en [0, 1000), 10 bits), asi que cada bloque se envia
+ con referencia (frame of reference) y empaquetado de bits: una cabecera con
+ el minimo del bloque y los bits que hacen falta para la diferencia con el
+ minimo, y detras cada fila con esas diferencias seguidas, de 'bits' en 'bits',
+ en palabras de 64 bits. Todas las filas ocupan las mismas palabras, asi que se
+ descomprimen en paralelo (cada hilo sus filas, las mismas que luego multiplica).
+ El formato solo sirve para tipos enteros; un bloque de valores cualesquiera
+ ocupa como mucho la cabecera y una palabra por fila mas que sin comprimir.
+ El proceso 0 comprime cada bloque una vez por matriz (MatrizDistribuida::
+ prepara) y cada proceso descomprime el suyo al recibirlo; no hay compresion
+ al leer de fichero, en el producto disperso ni con el reparto segmentado.
+ ============================================================================
+ */
+
+#ifndef COMPRESION_MXV_H
+#define COMPRESION_MXV_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "kernel_mxv.h"
+
+const long PALABRAS_CABECERA_COMPRIMIDA = 2; // Minimo del bloque y bits por elemento
+
+// Palabras de 64 bits que ocupa una fila de 'columnas' elementos de 'bits' bits
+inline long palabrasFilaComprimida(long columnas, int bits) {
+    return (columnas * bits + 63) / 64;
+}
+
+// Minimo del bloque y bits que ocupa la mayor diferencia con el
+template <typename S>
+void rangoBloque(const S *A, long ld, long filas, long columnas, long long &minimo, int &bits) {
+    long long maximo = 0;
+    minimo = 0;
+    for (long i = 0; i < filas; i++) {
+        for (long j = 0; j < columnas; j++) {
+            long long valor = A[i * ld + j];
+            if ((i == 0 && j == 0) || valor < minimo) minimo = valor;
+            if ((i == 0 && j == 0) || valor > maximo) maximo = valor;
+        }
+    }
+    unsigned long long diferencia = (unsigned long long) maximo - (unsigned long long) minimo;
+    bits = diferencia == 0 ? 0 : 64 - __builtin_clzll(diferencia);
+}
+
+// Palabras de 64 bits que ocupa comprimido el bloque de 'filas' x 'columnas' (distancia 'ld')
+template <typename S>
+long palabrasComprimido(const S *A, long ld, long filas, long columnas) {
+    long long minimo;
+    int bits;
+    rangoBloque(A, ld, filas, columnas, minimo, bits);
+    return PALABRAS_CABECERA_COMPRIMIDA + filas * palabrasFilaComprimida(columnas, bits);
+}
+
+/*
+ Comprime el bloque de 'filas' x 'columnas' (distancia 'ld') en 'destino', que
+ debe tener sitio para palabrasComprimido() palabras. Devuelve las palabras escritas.
+ */
+template <typename S>
+long comprimeBloque(const S *A, long ld, long filas, long columnas, unsigned long long *destino) {
+    long long minimo;
+    int bits;
+    rangoBloque(A, ld, filas, columnas, minimo, bits);
+    destino[0] = (unsigned long long) minimo;
+    destino[1] = bits;
+    long palabrasFila = palabrasFilaComprimida(columnas, bits);
+    unsigned long long *datos = destino + PALABRAS_CABECERA_COMPRIMIDA;
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < filas; i++) {
+        unsigned long long *fila = &datos[i * palabrasFila];
+        for (long p = 0; p < palabrasFila; p++) {
+            fila[p] = 0;
+        }
+        for (long j = 0; j < columnas && bits > 0; j++) {
+            unsigned long long valor = (unsigned long long) (long long) A[i * ld + j] - (unsigned long long) minimo;
+            long bit = j * bits;
+            int desplazamiento = bit % 64;
+            fila[bit / 64] |= valor << desplazamiento;
+            if (desplazamiento + bits > 64) {
+                fila[bit / 64 + 1] |= valor >> (64 - desplazamiento);
+            }
+        }
+    }
+    return PALABRAS_CABECERA_COMPRIMIDA + filas * palabrasFila;
+}
+
+/*
+ Descomprime en el bloque 'A' (distancia 'ld') los 'filas' x 'columnas'
+ elementos comprimidos en 'origen'. Los hilos se reparten las filas igual que
+ productoBloque.
+ */
+template <typename S>
+void descomprimeBloque(const unsigned long long *origen, long filas, long columnas, S *A, long ld) {
+    long long minimo = (long long) origen[0];
+    int bits = (int) origen[1];
+    long palabrasFila = palabrasFilaComprimida(columnas, bits);
+    unsigned long long mascara = bits == 64 ? ~0ULL : (1ULL << bits) - 1;
+    const unsigned long long *datos = origen + PALABRAS_CABECERA_COMPRIMIDA;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        long inicio = 0, fin = filas;
+#ifdef _OPENMP
+        filasHilo(filas, omp_get_thread_num(), omp_get_num_threads(), inicio, fin);
+#endif
+        for (long i = inicio; i < fin; i++) {
+            const unsigned long long *fila = &datos[i * palabrasFila];
+            S *destino = &A[i * ld];
+            for (long j = 0; j < columnas; j++) {
+                unsigned long long valor = 0;
+                if (bits > 0) {
+                    long bit = j * bits;
+                    int desplazamiento = bit % 64;
+                    valor = fila[bit / 64] >> desplazamiento;
+                    if (desplazamiento + bits > 64) {
+                        valor |= fila[bit / 64 + 1] << (64 - desplazamiento);
+                    }
+                }
+                destino[j] = (S) (long long) ((valor & mascara) + (unsigned long long) minimo);
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,263 @@
+/*
+ ============================================================================
+ Name        : csr_mxv.h
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Matrices dispersas en formato CSR para MatrizDispersa (dispersa_mxv.h).
+    - Generador determinista de filas dispersas (mismos valores que la matriz
+      densa en las posiciones no nulas).
+    - Reparto de filas equilibrado por numero de no nulos.
+    - Intercambio de los valores de x que necesita cada proceso (halo): se
+      calcula una vez que valores pide cada proceso a cada propietario y en cada
+      producto solo se envian esos, con MPI_Neighbor_alltoallv.
+    - Nucleo SpMV local.
+
+ El vector x se reparte con el mismo reparto que las filas: el proceso que
+ calcula y[i] es el propietario de x[i], asi que en el modo iterativo el
+ resultado local es directamente el trozo local del siguiente x.
+ ============================================================================
+ */
+
+#ifndef CSR_MXV_H
+#define CSR_MXV_H
+
+#include <algorithm>
+#include <mpi.h>
+#include <vector>
+
+#include "generador_mxv.h"
+#include "utilidades_mxv.h"
+
+template <typename T>
+struct MatrizCSR {
+    long filas; // Filas locales
+    std::vector<long> inicioFila; // filas + 1 posiciones
+    std::vector<long> columna; // Columna global de cada no nulo (solo mientras se construye)
+    std::vector<int> columnaLocal; // Posicion de cada no nulo en el x local (propios + halo)
+    std::vector<T> valor;
+};
+
+/*
+ Columnas no nulas de la fila i (ordenadas y sin repetir) de una matriz n x n con
+ unos 'media' no nulos por fila. El numero de no nulos crece con i (las ultimas
+ filas tienen el doble de la media y las primeras casi ninguno) y la mayoria de
+ columnas estan en una banda alrededor de la diagonal, con un 10% repartidas
+ por toda la fila.
+ */
+inline void columnasFilaDispersa(unsigned long long semilla, long n, long media, long i, std::vector<long> &columnas) {
+    unsigned long long semillaFila = mezclaBits(semilla ^ 0x5DEECE66DULL) + i;
+    long maximo = (4 * media * (i + 1)) / n;
+    long nnz = std::min(n, 1 + (long) (aleatorioEn(semillaFila, 0) % (maximo + 1)));
+    long ancho = std::max(16L, 4 * media);
+    columnas.clear();
+    for (long c = 0; c < nnz; c++) {
+        unsigned long long u = aleatorioEn(semillaFila, c + 1);
+        if (u % 10 == 0) {
+            columnas.push_back((long) ((u / 10) % n));
+        } else {
+            long desplazamiento = (long) ((u / 10) % (2 * ancho + 1)) - ancho;
+            columnas.push_back(((i + desplazamiento) % n + n) % n);
+        }
+    }
+    std::sort(columnas.begin(), columnas.end());
+    columnas.erase(std::unique(columnas.begin(), columnas.end()), columnas.end());
+}
+
+// Genera las filas [fila0, fila0 + filas) en 'A'
+template <typename T>
+void generaFilasDispersas(unsigned long long semilla, long n, long media, long fila0, long filas, MatrizCSR<T> &A) {
+    std::vector<long> columnas;
+    A.filas = filas;
+    A.inicioFila.assign(1, 0);
+    A.columna.clear();
+    A.valor.clear();
+    for (long i = fila0; i < fila0 + filas; i++) {
+        columnasFilaDispersa(semilla, n, media, i, columnas);
+        for (size_t c = 0; c < columnas.size(); c++) {
+            A.columna.push_back(columnas[c]);
+            A.valor.push_back(valorMatriz<T>(semilla, n, i, columnas[c]));
+        }
+        A.inicioFila.push_back(A.columna.size());
+    }
+}
+
+/*
+ Reparte n filas entre P procesos de forma que cada uno tenga aproximadamente el
+ mismo coste total; 'coste' es el coste de cada fila. Devuelve en 'inicio' (P + 1
+ posiciones) la primera fila de cada proceso.
+ */
+inline void repartoPorCoste(const std::vector<long> &coste, int P, std::vector<long> &inicio) {
+    long n = coste.size();
+    long total = 0;
+    for (long i = 0; i < n; i++) {
+        total += coste[i];
+    }
+    inicio.assign(P + 1, n);
+    inicio[0] = 0;
+    long acumulado = 0;
+    int r = 1;
+    for (long i = 0; i < n && r < P; i++) {
+        acumulado += coste[i];
+        // El proceso r empieza en la primera fila tras alcanzar r / P del coste total
+        while (r < P && acumulado * P >= total * r) {
+            inicio[r++] = i + 1;
+        }
+    }
+}
+
+/*
+ Plan del intercambio de x: que posiciones locales se envian a cada vecino y
+ cuantos valores se reciben de cada uno. Se calcula una vez.
+ */
+struct PlanHalo {
+    MPI_Comm vecindad; // Topologia de grafo con los vecinos reales
+    std::vector<int> cuentasEnvio, desplEnvio; // Por destino, en posiciones
+    std::vector<int> cuentasRecepcion, desplRecepcion; // Por origen, en posiciones
+    std::vector<int> indicesEnvio; // Posiciones locales de x que se envian
+    long propios; // Elementos de x de los que este proceso es propietario
+    long fantasmas; // Elementos de x que se reciben de otros procesos
+};
+
+/*
+ Calcula el plan de intercambio y convierte las columnas globales de 'A' en
+ posiciones del x local: [0, propios) son las propias y [propios, propios +
+ fantasmas) las recibidas, ordenadas por propietario y columna.
+ */
+template <typename T>
+void preparaHalo(MatrizCSR<T> &A, const std::vector<long> &inicio, MPI_Comm comunicador, PlanHalo &plan) {
+    int P, id;
+    MPI_Comm_size(comunicador, &P);
+    MPI_Comm_rank(comunicador, &id);
+    long primera = inicio[id];
+    plan.propios = inicio[id + 1] - primera;
+
+    // Columnas ajenas que necesitamos, ordenadas (y por tanto agrupadas por propietario)
+    std::vector<long> ajenas;
+    for (size_t p = 0; p < A.columna.size(); p++) {
+        if (A.columna[p] < primera || A.columna[p] >= inicio[id + 1]) {
+            ajenas.push_back(A.columna[p]);
+        }
+    }
+    std::sort(ajenas.begin(), ajenas.end());
+    ajenas.erase(std::unique(ajenas.begin(), ajenas.end()), ajenas.end());
+    plan.fantasmas = ajenas.size();
+
+    std::vector<int> pedidas(P, 0); // Columnas que pedimos a cada proceso
+    for (size_t c = 0; c < ajenas.size(); c++) {
+        int propietario = std::upper_bound(inicio.begin(), inicio.end(), ajenas[c]) - inicio.begin() - 1;
+        pedidas[propietario]++;
+    }
+    std::vector<int> solicitadas(P, 0); // Columnas que nos pide cada proceso
+    MPI_Alltoall(&pedidas[0], 1, MPI_INT, &solicitadas[0], 1, MPI_INT, comunicador);
+
+    std::vector<int> desplPedidas(P, 0), desplSolicitadas(P, 0);
+    for (int r = 1; r < P; r++) {
+        desplPedidas[r] = desplPedidas[r - 1] + pedidas[r - 1];
+        desplSolicitadas[r] = desplSolicitadas[r - 1] + solicitadas[r - 1];
+    }
+    std::vector<long> solicitudes(desplSolicitadas[P - 1] + solicitadas[P - 1] + 1);
+    MPI_Alltoallv(ajenas.empty() ? NULL : &ajenas[0], &pedidas[0], &desplPedidas[0], MPI_LONG,
+            &solicitudes[0], &solicitadas[0], &desplSolicitadas[0], MPI_LONG, comunicador);
+
+    // Vecinos: origenes son los procesos a los que pedimos, destinos los que nos piden
+    std::vector<int> origenes, destinos;
+    plan.cuentasEnvio.clear();
+    plan.desplEnvio.clear();
+    plan.cuentasRecepcion.clear();
+    plan.desplRecepcion.clear();
+    plan.indicesEnvio.clear();
+    for (int r = 0; r < P; r++) {
+        if (pedidas[r] > 0) {
+            origenes.push_back(r);
+            plan.cuentasRecepcion.push_back(pedidas[r]);
+            plan.desplRecepcion.push_back(desplPedidas[r]);
+        }
+        if (solicitadas[r] > 0) {
+            destinos.push_back(r);
+            plan.cuentasEnvio.push_back(solicitadas[r]);
+            plan.desplEnvio.push_back(plan.indicesEnvio.size());
+            for (int s = 0; s < solicitadas[r]; s++) {
+                plan.indicesEnvio.push_back(solicitudes[desplSolicitadas[r] + s] - primera);
+            }
+        }
+    }
+    MPI_Dist_graph_create_adjacent(comunicador,
+            origenes.size(), origenes.empty() ? MPI_WEIGHTS_EMPTY : &origenes[0], MPI_UNWEIGHTED,
+            destinos.size(), destinos.empty() ? MPI_WEIGHTS_EMPTY : &destinos[0], MPI_UNWEIGHTED,
+            MPI_INFO_NULL, 0, &plan.vecindad);
+
+    // Columnas globales -> posiciones del x local
+    A.columnaLocal.resize(A.columna.size());
+    for (size_t p = 0; p < A.columna.size(); p++) {
+        long c = A.columna[p];
+        if (c >= primera && c < inicio[id + 1]) {
+            A.columnaLocal[p] = c - primera;
+        } else {
+            A.columnaLocal[p] = plan.propios + (std::lower_bound(ajenas.begin(), ajenas.end(), c) - ajenas.begin());
+        }
+    }
+    std::vector<long>().swap(A.columna);
+}
+
+/*
+ Envia a cada vecino los valores de x que necesita y recibe los fantasmas detras
+ de los propios en 'xLocal' ('k' valores por posicion). 'envio' debe tener sitio
+ para indicesEnvio.size() * k elementos.
+ */
+template <typename T>
+void intercambiaHalo(const PlanHalo &plan, T *xLocal, int k, T *envio, MPI_Datatype tipoPosicion) {
+    for (size_t s = 0; s < plan.indicesEnvio.size(); s++) {
+        for (int v = 0; v < k; v++) {
+            envio[s * k + v] = xLocal[(long) plan.indicesEnvio[s] * k + v];
+        }
+    }
+    MPI_Neighbor_alltoallv(envio, plan.cuentasEnvio.empty() ? NULL : &plan.cuentasEnvio[0],
+            plan.desplEnvio.empty() ? NULL : &plan.desplEnvio[0], tipoPosicion,
+            &xLocal[plan.propios * k], plan.cuentasRecepcion.empty() ? NULL : &plan.cuentasRecepcion[0],
+            plan.desplRecepcion.empty() ? NULL : &plan.desplRecepcion[0], tipoPosicion, plan.vecindad);
+}
+
+/*
+ Producto local y = A * x con A en CSR y x en el orden local (propios + halo),
+ con las filas repartidas entre los hilos del proceso si se compila con -fopenmp.
+ Con k = 1 cada fila se acumula en dos sumas independientes para no encadenar
+ la latencia de la suma; con k > 1 cada no nulo se usa para los k vectores.
+ */
+template <typename T>
+void productoCSR(const MatrizCSR<T> &A, const T *x, T *y, int k) {
+    const long *inicio = &A.inicioFila[0];
+    const int *columna = A.columnaLocal.empty() ? NULL : &A.columnaLocal[0];
+    const T *valor = A.valor.empty() ? NULL : &A.valor[0];
+    if (k == 1) {
+#pragma omp parallel for schedule(static)
+        for (long i = 0; i < A.filas; i++) {
+            T s0 = 0, s1 = 0;
+            long p = inicio[i];
+            for (; p + 1 < inicio[i + 1]; p += 2) {
+                s0 += valor[p] * x[columna[p]];
+                s1 += valor[p + 1] * x[columna[p + 1]];
+            }
+            if (p < inicio[i + 1]) {
+                s0 += valor[p] * x[columna[p]];
+            }
+            y[i] = s0 + s1;
+        }
+        return;
+    }
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < A.filas; i++) {
+        T *filaY = &y[i * k];
+        for (int v = 0; v < k; v++) {
+            filaY[v] = 0;
+        }
+        for (long p = inicio[i]; p < inicio[i + 1]; p++) {
+            const T *xj = &x[(long) columna[p] * k];
+            for (int v = 0; v < k; v++) {
+                filaY[v] += valor[p] * xj[v];
+            }
+        }
+    }
+}
+
+#endif
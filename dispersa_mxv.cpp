@@ -0,0 +1,175 @@
+/*
+ ============================================================================
+ Name        : dispersa_mxv.cpp
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Implementacion de MatrizDispersa (dispersa_mxv.h) en libmxv:
+    reparto por no nulos, plan del halo y producto CSR repartido.
+
+ Build: make libmxv.a libmxv.so
+ ============================================================================
+ */
+
+#include <algorithm>
+#include <mpi.h>
+#include <vector>
+
+// Las envolturas PMPI las define cada programa; aqui solo se anota el calculo (perfil_mxv.h)
+#define PERFIL_MXV_SIN_ENVOLTURAS
+
+#include "csr_mxv.h"
+#include "dispersa_mxv.h"
+#include "perfil_mxv.h"
+#include "utilidades_mxv.h"
+#include "verificacion_mxv.h"
+
+using namespace std;
+
+template <typename T>
+MatrizDispersa<T>::MatrizDispersa(MPI_Comm comunicador)
+        : comunicador(comunicador), planificada(false), MPI_POSICION(MPI_DATATYPE_NULL), xLocal(NULL), envio(NULL),
+          semillaFreivalds(0), hayProyeccion(false), fases(NULL), tCalculo(0), tIteraciones(0) {
+    MPI_Comm_size(comunicador, &P);
+    MPI_Comm_rank(comunicador, &id);
+    plan.vecindad = MPI_COMM_NULL;
+    plan.propios = plan.fantasmas = 0;
+    abft[0] = abft[1] = 0;
+}
+
+template <typename T>
+MatrizDispersa<T>::~MatrizDispersa() {
+    libera();
+}
+
+template <typename T>
+void MatrizDispersa<T>::libera() {
+    if (!planificada) {
+        return;
+    }
+    MPI_Type_free(&MPI_POSICION);
+    MPI_Comm_free(&plan.vecindad);
+    delete [] xLocal;
+    delete [] envio;
+    xLocal = envio = NULL;
+    hayProyeccion = false;
+    planificada = false;
+}
+
+template <typename T>
+void MatrizDispersa<T>::planifica(const ConfiguracionMxv &configuracion) {
+    libera();
+    config = configuracion;
+    const long n = config.n;
+    double tFase = MPI_Wtime();
+
+    // Coste de cada fila (sus no nulos mas uno por la escritura de y), contado con un
+    // reparto provisional en filas iguales
+    vector<long> provisional(P + 1);
+    repartoFilas(n, P, NULL, &provisional[0]);
+    long fila0 = provisional[id];
+    long filas = provisional[id + 1] - fila0;
+    vector<long> coste(n), misCostes(filas + 1);
+    vector<long> columnas;
+    for (long i = 0; i < filas; i++) {
+        columnasFilaDispersa(config.semilla, n, config.noNulosFila, fila0 + i, columnas);
+        misCostes[i] = columnas.size() + 1;
+    }
+    vector<int> cuentasCoste(P), desplCoste(P);
+    for (int r = 0; r < P; r++) {
+        cuentasCoste[r] = provisional[r + 1] - provisional[r];
+        desplCoste[r] = provisional[r];
+    }
+    MPI_Allgatherv(&misCostes[0], filas, MPI_LONG, &coste[0], &cuentasCoste[0], &desplCoste[0], MPI_LONG, comunicador);
+
+    // Reparto definitivo, equilibrado por no nulos, y filas locales en CSR
+    repartoPorCoste(coste, P, inicio);
+    generaFilasDispersas(config.semilla, n, config.noNulosFila, inicio[id], inicio[id + 1] - inicio[id], A);
+    preparaHalo(A, inicio, comunicador, plan);
+
+    // Recogida de y en posiciones de k elementos, para que las cuentas quepan en un int
+    cuentasY.resize(P);
+    desplY.resize(P);
+    for (int r = 0; r < P; r++) {
+        cuentasY[r] = inicio[r + 1] - inicio[r];
+        desplY[r] = inicio[r];
+    }
+    MPI_Type_contiguous(config.k, tipoMPI<T>(), &MPI_POSICION);
+    MPI_Type_commit(&MPI_POSICION);
+
+    xLocal = new T [(plan.propios + plan.fantasmas) * config.k + 1];
+    envio = new T [plan.indicesEnvio.size() * config.k + 1];
+    filaControl.clear();
+    if (config.abft) {
+        filaControl.resize(plan.propios + plan.fantasmas + 1);
+        sumaColumnas(A, plan.propios + plan.fantasmas, &filaControl[0]);
+    }
+    abft[0] = abft[1] = 0;
+    planificada = true;
+    anotaFase(FASE_REPARTO_A, tFase);
+}
+
+template <typename T>
+void MatrizDispersa<T>::ejecuta(const T *x, T *y) {
+    const int k = config.k;
+    double tFase = MPI_Wtime();
+    copy(x, x + plan.propios * k, xLocal);
+    intercambiaHalo(plan, xLocal, k, envio, MPI_POSICION);
+    anotaFase(FASE_REPARTO_X, tFase);
+
+    MPI_Barrier(comunicador);
+    double tInicio = MPI_Wtime();
+    productoCSR(A, xLocal, y, k);
+    if (config.abft) {
+        abft[0]++;
+        abft[1] += compruebaControl(&filaControl[0], plan.propios + plan.fantasmas, xLocal, y, plan.propios, k);
+    }
+    anotaCalculo(tInicio, MPI_Wtime(), (double) A.valor.size() * (sizeof(T) + sizeof(int)));
+    MPI_Barrier(comunicador);
+    tCalculo = MPI_Wtime() - tInicio;
+    anotaFase(FASE_CALCULO, tInicio);
+}
+
+template <typename T>
+int MatrizDispersa<T>::itera(T *x, T *y, int iteraciones, double tolerancia) {
+    int realizadas = 0, continuar = 1;
+    tIteraciones = 0;
+    while (continuar) {
+        ejecuta(x, y);
+        tIteraciones += tCalculo;
+        realizadas++;
+
+        // El resultado local es el trozo local del siguiente x
+        continuar = 0;
+        if (realizadas < iteraciones) {
+            double tFase = MPI_Wtime();
+            continuar = reescalaRepartido(y, x, plan.propios * config.k, tolerancia, comunicador);
+            anotaFase(FASE_REDUCCION, tFase);
+        }
+    }
+    return realizadas;
+}
+
+template <typename T>
+void MatrizDispersa<T>::recogeY(const T *trozo, T *y) {
+    double tFase = MPI_Wtime();
+    MPI_Gatherv(trozo, plan.propios, MPI_POSICION, y, &cuentasY[0], &desplY[0], MPI_POSICION, 0, comunicador);
+    anotaFase(FASE_RECOGIDA, tFase);
+}
+
+// w^T x con las filas locales y el x local (propios y halo) del ultimo producto, y r^T y con el trozo de y.
+// w = r^T A se calcula una vez por matriz y semilla
+template <typename T>
+long MatrizDispersa<T>::compruebaFreivalds(unsigned long long semilla, const T *y) {
+    if (!hayProyeccion || semillaFreivalds != semilla) {
+        proyeccionFreivalds(semilla, A, inicio[id], plan.propios + plan.fantasmas, wFreivalds);
+        semillaFreivalds = semilla;
+        hayProyeccion = true;
+    }
+    return ::compruebaFreivalds(semilla, wFreivalds, xLocal, config.k, y, inicio[id], plan.propios, comunicador);
+}
+
+template class MatrizDispersa<int>;
+template class MatrizDispersa<long>;
+template class MatrizDispersa<float>;
+template class MatrizDispersa<double>;
@@ -0,0 +1,115 @@
+/*
+ ============================================================================
+ Name        : dispersa_mxv.h
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Producto matriz-vector disperso repartido de libmxv (--sparse D
+    de matriz_x_vector.cpp): la clase MatrizDispersa, que se usa igual que
+    MatrizDistribuida con yRepartido.
+
+ La matriz tiene unos D no nulos por fila de media y se guarda en formato CSR
+ (csr_mxv.h): cada proceso genera solo sus filas y la memoria y el trafico son
+ proporcionales al numero de no nulos, no a n^2. Las filas se reparten de
+ forma que cada proceso tenga aproximadamente el mismo numero de no nulos, y x
+ queda repartido igual que las filas: en lugar de difundir x entero, cada
+ proceso recibe de sus vecinos solo los elementos de x que aparecen en las
+ columnas de sus filas (intercambio de halo precalculado en planifica()).
+ ============================================================================
+ */
+
+#ifndef DISPERSA_MXV_H
+#define DISPERSA_MXV_H
+
+#include <mpi.h>
+#include <vector>
+
+#include "csr_mxv.h"
+#include "distribuida_mxv.h"
+#include "fases_mxv.h"
+
+/*
+ Matriz dispersa de n x n elementos de tipo T repartida por filas entre los
+ procesos de un comunicador. De la ConfiguracionMxv usa n, k, semilla,
+ noNulosFila y abft. x e y son siempre el trozo de cada proceso (posiciones()
+ posiciones a partir de primeraPosicion()). Todos los metodos salvo las
+ consultas son colectivos.
+ */
+template <typename T>
+class MatrizDispersa {
+public:
+    explicit MatrizDispersa(MPI_Comm comunicador);
+    ~MatrizDispersa();
+
+    /*
+     Reparte las filas por no nulos, genera las de este proceso y calcula el
+     plan del halo. Todo se anota como una sola fase de reparto de A.
+     */
+    void planifica(const ConfiguracionMxv &configuracion);
+
+    void ejecuta(const T *x, T *y);
+
+    // Como MatrizDistribuida::itera con yRepartido
+    int itera(T *x, T *y, int iteraciones, double tolerancia);
+
+    // Reune en el proceso 0 el 'trozo' de y de cada proceso
+    void recogeY(const T *trozo, T *y);
+
+    // Comprobacion de Freivalds del ultimo producto; devuelve en el proceso 0 los vectores incorrectos
+    long compruebaFreivalds(unsigned long long semilla, const T *y);
+
+    void anotaFases(MedidorFases *medidor) {
+        fases = medidor;
+    }
+
+    const long *primeraFila() const { return &inicio[0]; } // P + 1 posiciones
+    long primeraPosicion() const { return inicio[id]; }
+    long posiciones() const { return plan.propios; }
+    long noNulos() const { return A.valor.size(); } // De este proceso
+    long fantasmas() const { return plan.fantasmas; } // Posiciones de x que recibe en cada producto
+    double tiempoCalculo() const { return tCalculo; }
+    double tiempoIteraciones() const { return tIteraciones; }
+    long productosComprobados() const { return abft[0]; }
+    long fallosAbft() const { return abft[1]; }
+
+private:
+    MatrizDispersa(const MatrizDispersa &);
+    MatrizDispersa &operator=(const MatrizDispersa &);
+
+    void libera();
+
+    void anotaFase(Fase fase, double inicio) {
+        if (fases != NULL) {
+            fases->anota(fase, MPI_Wtime() - inicio);
+        }
+    }
+
+    MPI_Comm comunicador;
+    int P, id;
+    ConfiguracionMxv config;
+    bool planificada;
+
+    std::vector<long> inicio; // Primera fila de cada proceso
+    std::vector<int> cuentasY, desplY; // Trozos de y de todos los procesos, en posiciones
+    MatrizCSR<T> A;
+    PlanHalo plan;
+    MPI_Datatype MPI_POSICION; // Los k valores de una posicion de x o y
+
+    T *xLocal; // Primero las posiciones propias y detras las recibidas de los vecinos
+    T *envio;
+    std::vector<T> filaControl; // Fila de control (abft) sobre las posiciones del x local
+    long abft[2];
+    std::vector<typename TipoControl<T>::tipo> wFreivalds; // Proyeccion de Freivalds de las filas locales...
+    unsigned long long semillaFreivalds; // ...con esta semilla...
+    bool hayProyeccion; // ...si ya se ha calculado desde planifica()
+
+    MedidorFases *fases;
+    double tCalculo, tIteraciones;
+};
+
+extern template class MatrizDispersa<int>;
+extern template class MatrizDispersa<long>;
+extern template class MatrizDispersa<float>;
+extern template class MatrizDispersa<double>;
+
+#endif
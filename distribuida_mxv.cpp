@@ -0,0 +1,998 @@
+/*
+ ============================================================================
+ Name        : distribuida_mxv.cpp
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Implementacion de MatrizDistribuida (distribuida_mxv.h), la
+    biblioteca libmxv: el plan, el reparto de A y el producto repartido por
+    filas, por columnas o por submatrices de matriz_x_vector.cpp y
+    bidimensional_matriz_x_vector.cpp.
+
+ Todo lo que no depende de los datos (reparto, comunicadores, tipos, cuentas,
+ buffers) se prepara en planifica(), y todo lo que depende solo de la matriz
+ completa del proceso 0 (compresion, filas de control) en prepara(), asi que
+ en ejecuta() solo quedan las colectivas y el calculo local.
+
+ Build: make libmxv.a libmxv.so
+ ============================================================================
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <mpi.h>
+#include <vector>
+
+// Las envolturas PMPI las define cada programa; aqui solo se anota el calculo (perfil_mxv.h)
+#define PERFIL_MXV_SIN_ENVOLTURAS
+
+#include "autoajuste_mxv.h"
+#include "colectivas_mxv.h"
+#include "compresion_mxv.h"
+#include "distribuida_mxv.h"
+#include "generador_mxv.h"
+#include "kernel_mxv.h"
+#include "perfil_mxv.h"
+#include "utilidades_mxv.h"
+#include "verificacion_mxv.h"
+
+using namespace std;
+
+/*
+ Trozo de y del proceso (f, c) de la malla con yRepartido: las filas del
+ bloque de filas f que estan tambien en el bloque de columnas c. Los trozos de
+ una fila de la malla cubren en orden las filas de su bloque (el reparto del
+ MPI_Reduce_scatter) y los de una columna las columnas del suyo (el x que
+ reune su MPI_Allgatherv). Con una sola columna (DISTRIBUCION_FILAS) el trozo
+ son las filas del proceso, y con una sola fila (DISTRIBUCION_COLUMNAS) sus
+ columnas, las mismas posiciones que su trozo de x. Devuelve su numero de
+ posiciones y en 'inicio' la primera.
+ */
+static long trozoY(const long *primeraFila, const long *primeraColumna, int f, int c, long &inicio) {
+    inicio = max(primeraFila[f], primeraColumna[c]);
+    long fin = min(primeraFila[f + 1], primeraColumna[c + 1]);
+    if (fin <= inicio) {
+        inicio = primeraColumna[c];
+        return 0;
+    }
+    return fin - inicio;
+}
+
+template <typename T, typename S>
+MatrizDistribuida<T, S>::MatrizDistribuida(MPI_Comm comunicador)
+        : comunicador(comunicador), planificada(false), bloque(NULL), ld(0), ficheroFlujo(MPI_FILE_NULL),
+          MPI_FILA_PANEL(MPI_DATATYPE_NULL), filasPanel(0), paneles(0), bytesFlujo(0), MPI_POSICION(MPI_DATATYPE_NULL),
+          MPI_FILA(MPI_DATATYPE_NULL), filas(MPI_COMM_NULL), columnas(MPI_COMM_NULL), xLocal(NULL), subFinal(NULL),
+          yFila(NULL), yNodo(NULL), yParcial(NULL), segmentos(1), repartoPendiente(false), pendiente(NULL), preparada(NULL), comprimida(NULL), miComprimido(NULL),
+          misPalabras(0), capacidadComprimido(0), palabrasTotales(0), controles(NULL), filaControl(NULL), semillaFreivalds(0),
+          hayProyeccion(false), fases(NULL),
+          tCalculo(0), tIteraciones(0) {
+    MPI_Comm_size(comunicador, &P);
+    MPI_Comm_rank(comunicador, &id);
+    proyeccion.base = NULL;
+    lecturaPanel[0] = lecturaPanel[1] = MPI_REQUEST_NULL;
+    panelLeido[0] = panelLeido[1] = -1;
+    memoria.nodo = MPI_COMM_NULL;
+    memoria.lideres = MPI_COMM_NULL;
+    nivelesFilas.nodo = nivelesFilas.lideres = nivelesColumnas.nodo = nivelesColumnas.lideres = MPI_COMM_NULL;
+    memoria.base = NULL;
+    memoria.nodos = 1;
+    abft[0] = abft[1] = 0;
+}
+
+template <typename T, typename S>
+MatrizDistribuida<T, S>::~MatrizDistribuida() {
+    libera();
+}
+
+template <typename T, typename S>
+void MatrizDistribuida<T, S>::libera() {
+    if (!planificada) return;
+    hayProyeccion = false;
+    liberaColectiva(difusionX);
+    liberaColectiva(reduccionY);
+    if (config.xCompartido) {
+        liberaRecogidaNodos(recogida);
+        liberaNodo(memoria);
+        memoria.nodos = 1;
+    } else {
+        delete [] xLocal;
+        delete [] subFinal;
+    }
+    xLocal = subFinal = yNodo = NULL;
+    delete [] yFila;
+    delete [] yParcial;
+    yFila = yParcial = NULL;
+    if (proyeccion.base != NULL) {
+        liberaProyeccion(proyeccion);
+    } else {
+        delete [] bloque;
+    }
+    bloque = NULL;
+    if (ficheroFlujo != MPI_FILE_NULL) {
+        // La lectura anticipada del primer panel puede seguir en curso
+        MPI_Waitall(2, lecturaPanel, MPI_STATUSES_IGNORE);
+        MPI_File_close(&ficheroFlujo);
+        MPI_Type_free(&MPI_FILA_PANEL);
+        panelLeido[0] = panelLeido[1] = -1;
+    }
+    delete [] comprimida;
+    delete [] miComprimido;
+    delete [] controles;
+    delete [] filaControl;
+    comprimida = miComprimido = NULL;
+    controles = filaControl = NULL;
+    misPalabras = capacidadComprimido = palabrasTotales = 0;
+    preparada = pendiente = NULL;
+    repartoPendiente = false;
+    MPI_Type_free(&MPI_POSICION);
+    if (MPI_FILA != MPI_DATATYPE_NULL) {
+        MPI_Type_free(&MPI_FILA);
+    }
+    for (size_t t = 0; t < tiposBloque.size(); t++) {
+        MPI_Type_free(&tiposBloque[t]);
+    }
+    tiposBloque.clear();
+    cuentasBloque.clear();
+    if (filas != MPI_COMM_NULL) {
+        MPI_Comm_free(&filas);
+        MPI_Comm_free(&columnas);
+    }
+    liberaNiveles(nivelesFilas);
+    liberaNiveles(nivelesColumnas);
+    planificada = false;
+}
+
+template <typename T, typename S>
+void MatrizDistribuida<T, S>::planifica(const ConfiguracionMxv &configuracion) {
+    libera();
+    config = configuracion;
+    const long n = config.n;
+    const int k = config.k;
+
+    /* ---------------------------------------------------------------------------------------------------------------------------
+        Reparto: la distribucion por filas es una malla de P x 1 procesos, con las filas proporcionales a la
+        capacidad de cada proceso (iguales salvo que se den pesos o se midan al calibrar)
+    --------------------------------------------------------------------------------------------------------------------------- */
+    pesosFilas.clear();
+    if (config.distribucion == DISTRIBUCION_FILAS) {
+        filasP = P;
+        columnasP = 1;
+        pesosFilas = config.pesos;
+        if (config.calibrar) {
+            double capacidad = midePotencia<T, S>(n, config.k);
+            pesosFilas.resize(P);
+            MPI_Allgather(&capacidad, 1, MPI_DOUBLE, &pesosFilas[0], 1, MPI_DOUBLE, comunicador);
+        }
+    } else if (config.distribucion == DISTRIBUCION_COLUMNAS) {
+        filasP = 1;
+        columnasP = P;
+    } else {
+        filasP = config.filasMalla;
+        columnasP = config.columnasMalla;
+        if (filasP == 0 || columnasP == 0) {
+            // Malla lo mas cuadrada posible para el numero de procesos
+            int dimensiones[2] = {0, 0};
+            MPI_Dims_create(P, 2, dimensiones);
+            filasP = dimensiones[0];
+            columnasP = dimensiones[1];
+        }
+    }
+    inicioFilas.resize(filasP + 1);
+    inicioColumnas.resize(columnasP + 1);
+    repartoFilas(n, filasP, pesosFilas.empty() ? NULL : &pesosFilas[0], &inicioFilas[0]);
+    repartoFilas(n, columnasP, NULL, &inicioColumnas[0]);
+
+    // Celda de cada proceso: en orden de rango, salvo con la malla colocada por nodos (solo por submatrices)
+    config.topologia = config.topologia && config.distribucion == DISTRIBUCION_BLOQUES;
+    celda.resize(P);
+    for (int i = 0; i < P; i++) {
+        celda[i] = i;
+    }
+    if (config.topologia) {
+        creaMallaNodos(comunicador, filasP, columnasP, celda, filas, columnas);
+    }
+    filaP = celda[id] / columnasP;
+    columnaP = celda[id] % columnasP;
+    fila0 = inicioFilas[filaP];
+    alto = inicioFilas[filaP + 1] - fila0;
+    columna0 = inicioColumnas[columnaP];
+    ancho = inicioColumnas[columnaP + 1] - columna0;
+    displenv.resize(P);
+    cuentasTrozoY.resize(P);
+    desplTrozoY.resize(P);
+    for (int i = 0; i < P; i++) {
+        long inicio;
+        displenv[i] = inicioFilas[celda[i] / columnasP] * n + inicioColumnas[celda[i] % columnasP];
+        cuentasTrozoY[i] = trozoY(&inicioFilas[0], &inicioColumnas[0], celda[i] / columnasP, celda[i] % columnasP, inicio);
+        desplTrozoY[i] = inicio;
+    }
+    posicionesY = cuentasTrozoY[id];
+    inicioY = desplTrozoY[id];
+
+    // Las cuentas de MPI son int, asi que A se reparte en filas completas (MPI_FILA) o submatrices y
+    // x e y en posiciones de k elementos (MPI_POSICION): las cuentas son numeros de filas o columnas
+    MPI_Type_contiguous(k, tipoMPI<T>(), &MPI_POSICION);
+    MPI_Type_commit(&MPI_POSICION);
+
+    segmentos = 1;
+    if (config.distribucion == DISTRIBUCION_FILAS) {
+        MPI_Type_contiguous(n, tipoMPI<S>(), &MPI_FILA);
+        MPI_Type_commit(&MPI_FILA);
+        if (config.carga == CARGA_RAIZ && !config.xCompartido && !config.comprimir) {
+            segmentos = max(1, config.segmentos);
+        }
+
+        /* -----------------------------------------------------------------------------------------------------------------------
+            Trozos del reparto segmentado
+            El trozo c del proceso r son sus filas [inicio(r, c), inicio(r, c + 1)); para cada trozo guardamos las
+            cuentas y desplazamientos de todos los procesos, en filas (las mismas para la matriz y para el
+            resultado), que deben seguir existiendo hasta que terminen las operaciones no bloqueantes.
+        ----------------------------------------------------------------------------------------------------------------------- */
+        if (segmentos > 1) {
+            cuentasTrozo.assign(segmentos * P, 0);
+            desplTrozo.assign(segmentos * P, 0);
+            inicioTrozo.assign(segmentos + 1, 0);
+            peticionResultado.assign(segmentos, MPI_REQUEST_NULL);
+            for (int r = 0; r < P; r++) {
+                int filasR = cuentasTrozoY[r];
+                for (int c = 0; c < segmentos; c++) {
+                    int ini = c * (filasR / segmentos) + min(c, filasR % segmentos);
+                    int fin = (c + 1) * (filasR / segmentos) + min(c + 1, filasR % segmentos);
+                    cuentasTrozo[c * P + r] = fin - ini;
+                    desplTrozo[c * P + r] = desplTrozoY[r] + ini;
+                    if (r == id) {
+                        inicioTrozo[c] = ini;
+                        inicioTrozo[c + 1] = fin;
+                    }
+                }
+            }
+        }
+    } else {
+        /* -----------------------------------------------------------------------------------------------------------------------
+            Creamos los comunicadores necesarios a partir del comunicador de la matriz
+            - filas: reune a los elementos de una misma fila, ordenados de izquierda a derecha
+                Usaremos este comunicador para recibir y reducir los subvalores de "y" en el primer proceso
+                de la fila. En la primera fila de la malla, ademas, el proceso 0 reparte (scatter) a cada
+                columna su trozo de x
+            - columnas: reune a los elementos de una misma columna, ordenados de arriba a abajo
+                Usaremos este comunicador para recibir la parte de x que necesitan todos los procesos de
+                una misma columna (Broadcast) desde el proceso de la primera fila. En la primera columna
+                de la malla, ademas, el proceso 0 recoge (gather) los resultados reducidos de cada fila
+            Con una malla no cuadrada no hay diagonal, asi que x entra por la primera fila y y sale por
+            la primera columna.
+        ----------------------------------------------------------------------------------------------------------------------- */
+        if (!config.topologia) {
+            MPI_Comm_split(comunicador, // a partir del comunicador de la matriz
+                filaP, // los de la misma fila entraran en el mismo comunicador
+                id, // indica el orden de asignacion de rango dentro de los nuevos comunicadores
+                &filas); // Referencia al nuevo comunicador creado.
+
+            MPI_Comm_split(comunicador, columnaP, id, &columnas);
+        } else {
+            // Con la malla colocada por nodos los comunicadores ya vienen de MPI_Cart_sub, y la reduccion
+            // de cada fila y la difusion de cada columna se hacen en dos niveles: nodo y entre nodos
+            creaNiveles(filas, nivelesFilas);
+            creaNiveles(columnas, nivelesColumnas);
+        }
+
+        // Trozos de x (por columnas de la malla) y de y (por filas de la malla), en posiciones
+        cuentasX.resize(columnasP);
+        desplX.resize(columnasP);
+        for (int c = 0; c < columnasP; c++) {
+            cuentasX[c] = inicioColumnas[c + 1] - inicioColumnas[c];
+            desplX[c] = inicioColumnas[c];
+        }
+        cuentasY.resize(filasP);
+        desplY.resize(filasP);
+        for (int f = 0; f < filasP; f++) {
+            cuentasY[f] = inicioFilas[f + 1] - inicioFilas[f];
+            desplY[f] = inicioFilas[f];
+        }
+        // Con yRepartido (y siempre con DISTRIBUCION_COLUMNAS): reparto del Reduce_scatter de esta fila
+        // de la malla (en elementos, para poder usar MPI_SUM) y trozos de la columna para el Allgatherv
+        // de x (en posiciones, desde la primera columna del bloque)
+        if (config.yRepartido || config.distribucion == DISTRIBUCION_COLUMNAS) {
+            long inicio;
+            cuentasReduccion.resize(columnasP);
+            for (int c = 0; c < columnasP; c++) {
+                cuentasReduccion[c] = trozoY(&inicioFilas[0], &inicioColumnas[0], filaP, c, inicio) * k;
+            }
+            cuentasXColumna.resize(filasP);
+            desplXColumna.resize(filasP);
+            for (int f = 0; f < filasP; f++) {
+                cuentasXColumna[f] = trozoY(&inicioFilas[0], &inicioColumnas[0], f, columnaP, inicio);
+                desplXColumna[f] = inicio - columna0;
+            }
+        }
+
+        /* -----------------------------------------------------------------------------------------------------------------------
+            Tipos del reparto de las submatrices directamente desde A
+            MPI_BLOQUE describe una submatriz dentro de A (MPI_Type_vector) y se redimensiona a la extension de
+            un solo elemento, asi que el desplazamiento de cada proceso en el Scatterv es la posicion de su primer
+            elemento en A y no hace falta copiar las submatrices a otra matriz antes de enviarlas. Si n no es
+            multiplo de las dimensiones de la malla hay hasta cuatro tamaños de submatriz; se hace un Scatterv
+            para cada tamaño, en el que solo reciben los procesos con ese tamaño.
+        ----------------------------------------------------------------------------------------------------------------------- */
+        if (config.carga == CARGA_RAIZ && !config.comprimir) {
+            for (long altoBloque = n / filasP; altoBloque <= n / filasP + 1; altoBloque++) {
+                for (long anchoBloque = n / columnasP; anchoBloque <= n / columnasP + 1; anchoBloque++) {
+                    vector<long> cuentas(P); // 1 para los procesos que reciben en este Scatterv
+                    int procesosBloque = 0;
+                    for (int i = 0; i < P; i++) {
+                        int filaI = celda[i] / columnasP, columnaI = celda[i] % columnasP;
+                        cuentas[i] = (inicioFilas[filaI + 1] - inicioFilas[filaI] == altoBloque
+                                && inicioColumnas[columnaI + 1] - inicioColumnas[columnaI] == anchoBloque);
+                        procesosBloque += cuentas[i];
+                    }
+                    if (procesosBloque == 0) continue;
+
+                    MPI_Datatype MPI_SUBMATRIZ, MPI_BLOQUE;
+                    MPI_Type_vector(altoBloque, anchoBloque, n, tipoMPI<S>(), &MPI_SUBMATRIZ);
+                    MPI_Type_create_resized(MPI_SUBMATRIZ, 0, sizeof(S), &MPI_BLOQUE);
+                    MPI_Type_commit(&MPI_BLOQUE);
+                    MPI_Type_free(&MPI_SUBMATRIZ);
+                    tiposBloque.push_back(MPI_BLOQUE);
+                    cuentasBloque.push_back(cuentas);
+                }
+            }
+        }
+    }
+
+    // Bloque local (salvo si se usa directamente el bloque proyectado del fichero, cuyas filas estan
+    // separadas n elementos, o si se lee por paneles, de los que solo hay dos en memoria)
+    bytesFlujo = 0;
+    if (config.carga == CARGA_FICHERO || config.carga == CARGA_PROYECCION || config.carga == CARGA_FLUJO) {
+        // El fichero se comprueba antes de leerlo: con un fichero truncado la lectura de un panel mas alla
+        // del final no termina en algunas implementaciones de MPI-IO, y en otras no se refleja en el estado
+        CabeceraMatriz cabecera;
+        if (!leeCabeceraMPI(config.fichero.c_str(), cabecera, comunicador) || cabecera.filas != n || cabecera.columnas != n
+                || bytesTipoDato((TipoDato) cabecera.tipo) != (long) sizeof(S)) {
+            if (id == 0) {
+                fprintf(stderr, "Error: el fichero %s no contiene una matriz de %ld x %ld elementos de %ld bytes\n",
+                        config.fichero.c_str(), n, n, (long) sizeof(S));
+            }
+            MPI_Abort(comunicador, 1);
+        }
+    }
+    if (config.carga == CARGA_PROYECCION) {
+        bloque = proyectaMatriz<S>(config.fichero.c_str(), proyeccion);
+        int proyectada = bloque != NULL, todasProyectadas;
+        MPI_Allreduce(&proyectada, &todasProyectadas, 1 /*count*/, MPI_INT, MPI_MIN, comunicador);
+        if (!todasProyectadas) {
+            if (id == 0) {
+                fprintf(stderr, "Error: no se pudo proyectar en memoria el fichero %s\n", config.fichero.c_str());
+            }
+            MPI_Abort(comunicador, 1);
+        }
+        bloque += fila0 * n + columna0;
+        ld = n;
+    } else if (config.carga == CARGA_FLUJO) {
+        // Cada proceso lee su bloque por su cuenta (MPI_COMM_SELF), a su ritmo, sin esperar al resto
+        filasPanel = max(1L, min(config.filasPanel, alto));
+        paneles = (alto + filasPanel - 1) / filasPanel;
+        bloque = new S [2 * filasPanel * ancho];
+        primerContacto(bloque, ancho, 2 * filasPanel, ancho);
+        ld = ancho;
+        abreBloqueMPIIO<S>(config.fichero.c_str(), n, fila0, alto, columna0, ancho, MPI_COMM_SELF, ficheroFlujo);
+        MPI_Type_contiguous(ancho, tipoMPI<S>(), &MPI_FILA_PANEL);
+        MPI_Type_commit(&MPI_FILA_PANEL);
+    } else {
+        bloque = new S [alto * ancho];
+        primerContacto(bloque, ancho, alto, ancho); // Cada hilo coloca en su nodo NUMA las filas que va a usar
+        ld = ancho;
+    }
+
+    // Con xCompartido, x e y estan una sola vez por nodo, en la memoria compartida de su lider, y el
+    // resultado local se escribe directamente en su sitio del y del nodo. Con yRepartido por filas el
+    // resultado local es el propio trozo de y que se pasa a ejecuta()
+    if (config.xCompartido) {
+        creaNodo(comunicador, 2 * n * k * sizeof(T), memoria);
+        xLocal = (T *) memoria.base;
+        yNodo = xLocal + n * k;
+        subFinal = &yNodo[fila0 * k];
+        preparaRecogidaNodos(memoria, &cuentasTrozoY[0], &desplTrozoY[0], MPI_POSICION, 0, comunicador, recogida);
+    } else {
+        xLocal = new T [ancho * k];
+        if (config.distribucion != DISTRIBUCION_FILAS || !config.yRepartido) {
+            subFinal = new T [alto * k];
+            primerContacto(subFinal, k, alto, k);
+        }
+        // Con colectivas persistentes el proceso 0 tambien reduce en yFila, porque el y de ejecuta() cambia
+        if (config.distribucion == DISTRIBUCION_BLOQUES && !config.yRepartido && columnaP == 0 && (id != 0 || config.persistentes)) {
+            yFila = new T [alto * k];
+        }
+        // Con la malla colocada por nodos, la suma del nodo en su lider antes de reducir entre nodos
+        if (config.topologia && !config.yRepartido && !config.persistentes && nivelesFilas.lideres != MPI_COMM_NULL
+                && nivelesFilas.nodos > 1 && nivelesFilas.procesosNodo > 1) {
+            yParcial = new T [alto * k];
+        }
+        // Con DISTRIBUCION_COLUMNAS, el trozo de y que deja a cada proceso el Reduce_scatter
+        if (config.distribucion == DISTRIBUCION_COLUMNAS && !config.yRepartido) {
+            yFila = new T [posicionesY * k + 1];
+        }
+    }
+
+    // La difusion de x y la reduccion de y de cada iteracion, con sus buffers ya fijos, se preparan
+    // una sola vez (colectivas_mxv.h)
+    if (config.persistentes && !config.yRepartido) {
+        if (config.distribucion == DISTRIBUCION_FILAS) {
+            if (!config.xCompartido) {
+                preparaBcastPersistente(xLocal, n, MPI_POSICION, 0, comunicador, difusionX);
+            } else if (memoria.lideres != MPI_COMM_NULL) {
+                preparaBcastPersistente(xLocal, n, MPI_POSICION, 0, memoria.lideres, difusionX);
+            }
+        } else {
+            preparaBcastPersistente(xLocal, ancho, MPI_POSICION, 0, columnas, difusionX);
+            if (config.distribucion == DISTRIBUCION_BLOQUES) {
+                preparaReducePersistente(subFinal, yFila, alto * k, tipoMPI<T>(), MPI_SUM, 0, filas, reduccionY);
+            }
+        }
+    }
+
+    // Fila de control de cada bloque (abft): la del proceso 0 se reparte desde 'controles'
+    abft[0] = abft[1] = 0;
+    if (config.abft) {
+        filaControl = new T [ancho];
+        if (config.carga == CARGA_RAIZ) {
+            cuentasControl.resize(P);
+            desplControl.resize(P);
+            for (int i = 0; i < P; i++) {
+                int filaI = celda[i] / columnasP, columnaI = celda[i] % columnasP;
+                cuentasControl[i] = inicioColumnas[columnaI + 1] - inicioColumnas[columnaI];
+                desplControl[i] = filaI * n + inicioColumnas[columnaI];
+            }
+            if (id == 0) {
+                controles = new T [filasP * n];
+            }
+        }
+    }
+    if (config.comprimir && id == 0) {
+        palabrasBloque.resize(P);
+        desplBloque.resize(P);
+    }
+    planificada = true;
+}
+
+template <typename T, typename S>
+void MatrizDistribuida<T, S>::prepara(const S *A) {
+    if (config.carga != CARGA_RAIZ || (!config.abft && !config.comprimir)) return;
+    // Solo el proceso 0 sabe si la matriz es otra
+    int nueva = (id == 0 && A != preparada);
+    MPI_Bcast(&nueva, 1, MPI_INT, 0, comunicador);
+    if (!nueva) return;
+    preparada = A;
+    const long n = config.n;
+
+    // Fila de control (suma de columnas) del bloque de cada proceso, que se envia con el bloque
+    if (config.abft && id == 0) {
+        for (int i = 0; i < P; i++) {
+            int filaI = celda[i] / columnasP, columnaI = celda[i] % columnasP;
+            sumaColumnas(&A[displenv[i]], n, inicioFilas[filaI + 1] - inicioFilas[filaI],
+                    inicioColumnas[columnaI + 1] - inicioColumnas[columnaI], &controles[filaI * n + inicioColumnas[columnaI]]);
+        }
+    }
+
+    // El proceso 0 comprime una sola vez el bloque de cada proceso y en cada reparto se envian
+    // los bloques comprimidos, en palabras de 64 bits
+    if (config.comprimir) {
+        if (id == 0) {
+            palabrasTotales = 0;
+            for (int i = 0; i < P; i++) {
+                int filaI = celda[i] / columnasP, columnaI = celda[i] % columnasP;
+                palabrasBloque[i] = palabrasComprimido(&A[displenv[i]], n, inicioFilas[filaI + 1] - inicioFilas[filaI],
+                        inicioColumnas[columnaI + 1] - inicioColumnas[columnaI]);
+                desplBloque[i] = palabrasTotales;
+                palabrasTotales += palabrasBloque[i];
+            }
+            delete [] comprimida;
+            comprimida = new unsigned long long [palabrasTotales];
+            for (int i = 0; i < P; i++) {
+                int filaI = celda[i] / columnasP, columnaI = celda[i] % columnasP;
+                comprimeBloque(&A[displenv[i]], n, inicioFilas[filaI + 1] - inicioFilas[filaI],
+                        inicioColumnas[columnaI + 1] - inicioColumnas[columnaI], &comprimida[desplBloque[i]]);
+            }
+        }
+        MPI_Scatter(id == 0 ? &palabrasBloque[0] : NULL, 1, MPI_LONG, &misPalabras, 1, MPI_LONG, 0, comunicador);
+        if (misPalabras > capacidadComprimido) {
+            delete [] miComprimido;
+            miComprimido = new unsigned long long [misPalabras];
+            capacidadComprimido = misPalabras;
+        }
+    }
+}
+
+template <typename T, typename S>
+void MatrizDistribuida<T, S>::reparte(const S *A) {
+    prepara(A);
+    hayProyeccion = false;
+    double tFase = MPI_Wtime();
+    const long n = config.n;
+    if (config.carga == CARGA_FICHERO) {
+        // Cada proceso lee su propio bloque del fichero
+        leeBloqueMPIIO(config.fichero.c_str(), n, fila0, alto, columna0, ancho, bloque, comunicador);
+    } else if (config.carga == CARGA_GENERADA) {
+        // Cada proceso genera su propio bloque
+        generaBloque(config.semilla, n, fila0, alto, columna0, ancho, bloque, ld);
+    } else if (config.carga == CARGA_RAIZ) {
+        if (config.comprimir) {
+            // Cada proceso recibe su bloque comprimido y lo descomprime
+            scattervGrande(comprimida, // Bloques comprimidos de todos los procesos
+                    id == 0 ? &palabrasBloque[0] : NULL, // Palabras del bloque de cada proceso
+                    id == 0 ? &desplBloque[0] : NULL, // Primera palabra del bloque de cada proceso
+                    MPI_UNSIGNED_LONG_LONG, // Tipo de dato a enviar
+                    miComprimido, // Vector en el que almacenar los datos
+                    misPalabras, // Numero de palabras a recibir
+                    MPI_UNSIGNED_LONG_LONG, // Tipo de dato a recibir
+                    0, // Proceso raiz que envia los datos
+                    comunicador); // Comunicador de la matriz
+            descomprimeBloque(miComprimido, alto, ancho, bloque, ld);
+        } else if (segmentos > 1) {
+            // Con reparto segmentado la matriz se envia dentro del siguiente producto
+            repartoPendiente = true;
+            pendiente = A;
+        } else if (config.distribucion == DISTRIBUCION_FILAS) {
+            MPI_Scatterv(A, // Matriz que vamos a compartir
+                    &cuentasTrozoY[0], // Numero de filas a compartir
+                    &desplTrozoY[0], // Desplazamiento (en filas) dentro de los datos a compartir
+                    MPI_FILA, // Tipo de dato a enviar
+                    bloque, // Vector en el que almacenar los datos
+                    alto, // Numero de filas a recibir
+                    MPI_FILA, // Tipo de dato a recibir
+                    0, // Proceso raiz que envia los datos
+                    comunicador); // Comunicador de la matriz
+        } else {
+            // Un Scatterv por tamaño de submatriz; los desplazamientos llegan hasta n * n, asi que se
+            // usa scattervGrande (colectivas_mxv.h), con cuentas de 64 bits
+            for (size_t t = 0; t < tiposBloque.size(); t++) {
+                scattervGrande(A, // Matriz que vamos a compartir
+                    &cuentasBloque[t][0], // Una submatriz para cada proceso de este tamaño, ninguna para el resto
+                    &displenv[0], // Posicion de cada submatriz dentro de A
+                    tiposBloque[t], // Tipo de dato a enviar
+                    bloque, // Vector en el que almacenar los datos
+                    cuentasBloque[t][id] ? alto * ancho : 0, // Numero de datos a recibir
+                    tipoMPI<S>(), // Tipo de dato a recibir
+                    0, // Proceso raiz que envia los datos
+                    comunicador); // Comunicador de la matriz
+            }
+        }
+    }
+    if (config.abft) {
+        // La fila de control viaja con el bloque; si no hay matriz completa se calcula donde se carga el bloque
+        if (config.carga == CARGA_FLUJO) {
+            // Una pasada por los paneles, sumando las columnas de cada uno
+            vector<T> suma(ancho);
+            fill(filaControl, filaControl + ancho, (T) 0);
+            for (long p = 0; p < paneles; p++) {
+                if (p + 1 < paneles) {
+                    leePanel(p + 1);
+                }
+                sumaColumnas(esperaPanel(p), ancho, min(filasPanel, alto - p * filasPanel), ancho, &suma[0]);
+                for (long j = 0; j < ancho; j++) {
+                    filaControl[j] += suma[j];
+                }
+            }
+        } else if (config.carga != CARGA_RAIZ) {
+            sumaColumnas(bloque, ld, alto, ancho, filaControl);
+        } else {
+            scattervGrande(controles, &cuentasControl[0], &desplControl[0], tipoMPI<T>(), filaControl, ancho, tipoMPI<T>(), 0, comunicador);
+        }
+    }
+    if (!repartoPendiente) {
+        anotaFase(FASE_REPARTO_A, tFase);
+    }
+}
+
+template <typename T, typename S>
+void MatrizDistribuida<T, S>::ejecuta(const T *x, T *y) {
+    if (config.distribucion == DISTRIBUCION_FILAS) {
+        ejecutaFilas(x, y);
+    } else {
+        ejecutaBloques(x, y);
+    }
+}
+
+template <typename T, typename S>
+int MatrizDistribuida<T, S>::itera(T *x, T *y, int iteraciones, double tolerancia) {
+    const long elementos = config.n * config.k;
+    int realizadas = 0, continuar = 1;
+    tIteraciones = 0;
+    while (continuar) {
+        ejecuta(x, y);
+        tIteraciones += tCalculo;
+        realizadas++;
+
+        continuar = 0;
+        if (!config.yRepartido) {
+            // El proceso 0 prepara el siguiente vector y decide si se sigue iterando
+            if (id == 0 && realizadas < iteraciones) {
+                T maximo = maximoAbsoluto(y, elementos);
+                continuar = (diferenciaReescalado(y, x, elementos, maximo) > tolerancia);
+                if (continuar) {
+                    reescalaVector(y, x, elementos, maximo);
+                }
+            }
+            MPI_Bcast(&continuar, 1, MPI_INT, 0, comunicador);
+        } else if (realizadas < iteraciones) {
+            double tFase = MPI_Wtime();
+            continuar = reescalaRepartido(y, x, posicionesY * config.k, tolerancia, comunicador);
+            anotaFase(FASE_REDUCCION, tFase);
+        }
+    }
+    return realizadas;
+}
+
+template <typename T, typename S>
+void MatrizDistribuida<T, S>::ejecutaFilas(const T *x, T *y) {
+    const long n = config.n;
+    const int k = config.k;
+
+    // Compartimos el vector entre todos los procesos
+    double tFase = MPI_Wtime();
+    if (config.xCompartido) {
+        // Solo los lideres reciben x, en la memoria de su nodo, y el resto lo lee de ahi
+        if (id == 0) {
+            copy(x, x + n * k, xLocal);
+        }
+        if (config.persistentes) {
+            ejecutaColectiva(difusionX);
+        } else if (memoria.lideres != MPI_COMM_NULL) {
+            MPI_Bcast(xLocal, n, MPI_POSICION, 0, memoria.lideres);
+        }
+        sincronizaNodo(memoria);
+    } else if (!config.yRepartido) {
+        if (id == 0) {
+            copy(x, x + n * k, xLocal);
+        }
+        if (config.persistentes) {
+            ejecutaColectiva(difusionX);
+        } else {
+            MPI_Bcast(xLocal, // Dato a compartir
+                    n, // Numero de posiciones (de los k vectores) que se van a enviar y recibir
+                    MPI_POSICION, // Tipo de dato que se compartira
+                    0, // Proceso raiz que envia los datos
+                    comunicador); // Comunicador de la matriz
+        }
+    } else {
+        // Cada proceso aporta su trozo de x y recibe el de los demas
+        MPI_Allgatherv(x, // Trozo de x de este proceso (sus filas)
+                alto, // Posiciones (de los k vectores) del trozo
+                MPI_POSICION, // Tipo del dato que se envia
+                xLocal, // Vector en el que se reune x
+                &cuentasTrozoY[0], // Posiciones de cada proceso
+                &desplTrozoY[0], // Primera posicion de cada proceso
+                MPI_POSICION, // Tipo del dato que se recibe
+                comunicador); // Comunicador de la matriz
+    }
+    anotaFase(FASE_REPARTO_X, tFase);
+
+    T *destino = config.yRepartido ? y : subFinal;
+    if (repartoPendiente) {
+        ejecutaSegmentado(destino, y, tFase);
+        return;
+    }
+
+    // Hacemos una barrera para asegurar que todas los procesos comiencen la ejecucion
+    // a la vez, para tener mejor control del tiempo empleado
+    MPI_Barrier(comunicador);
+    double tInicio = MPI_Wtime();
+
+    productoLocal(destino);
+    if (config.abft) {
+        abft[0]++;
+        abft[1] += compruebaControl(filaControl, ancho, xLocal, destino, alto, k);
+    }
+    // El calculo de cada proceso se anota antes de la barrera, que se anota aparte como espera
+    anotaCalculo(tInicio, MPI_Wtime(), (double) alto * ancho * sizeof(S));
+
+    // Otra barrera para asegurar que todas ejecuten el siguiente trozo de codigo lo
+    // mas proximamente posible
+    MPI_Barrier(comunicador);
+    double tFin = MPI_Wtime();
+    tCalculo = tFin - tInicio;
+    anotaFase(FASE_CALCULO, tInicio);
+
+    // Recogemos los datos de la multiplicacion en el proceso 0, en el mismo orden en el que
+    // se repartieron las filas
+    if (config.xCompartido) {
+        // Cada nodo tiene ya en su memoria las filas de sus procesos y su lider las envia juntas
+        sincronizaNodo(memoria);
+        recogeNodos(memoria, recogida, yNodo);
+        if (id == 0) {
+            copy(yNodo, yNodo + n * k, y);
+        }
+        anotaFase(FASE_RECOGIDA, tFin);
+    } else if (!config.yRepartido) {
+        MPI_Gatherv(subFinal, // Dato que envia cada proceso
+                alto, // Numero de posiciones (de los k vectores) que se envian
+                MPI_POSICION, // Tipo del dato que se envia
+                y, // Vector en el que se recolectan los datos
+                &cuentasTrozoY[0], // Numero de posiciones que se esperan recibir por cada proceso
+                &desplTrozoY[0], // displs (en filas)
+                MPI_POSICION, // Tipo del dato que se recibira
+                0, // proceso que va a recibir los datos
+                comunicador); // Comunicador de la matriz
+        anotaFase(FASE_RECOGIDA, tFin);
+    }
+}
+
+/*
+ Primer producto con reparto segmentado: como maximo hay dos trozos de A en
+ vuelo, el que se esta calculando y el siguiente, y el resultado de cada trozo
+ se devuelve mientras se calculan los siguientes. Reparto de A, calculo y
+ recogida solapados se anotan juntos como reparto de A.
+ */
+template <typename T, typename S>
+void MatrizDistribuida<T, S>::ejecutaSegmentado(T *destino, T *y, double tInicioReparto) {
+    const long n = config.n;
+    const int k = config.k;
+    MPI_Request peticionTrozo[2];
+    tCalculo = 0;
+    MPI_Iscatterv(pendiente, &cuentasTrozo[0], &desplTrozo[0], MPI_FILA,
+            &bloque[(long) inicioTrozo[0] * n], inicioTrozo[1] - inicioTrozo[0], MPI_FILA,
+            0, comunicador, &peticionTrozo[0]);
+    for (int c = 0; c < segmentos; c++) {
+        if (c + 1 < segmentos) {
+            MPI_Iscatterv(pendiente, &cuentasTrozo[(c + 1) * P], &desplTrozo[(c + 1) * P], MPI_FILA,
+                    &bloque[(long) inicioTrozo[c + 1] * n], inicioTrozo[c + 2] - inicioTrozo[c + 1], MPI_FILA,
+                    0, comunicador, &peticionTrozo[(c + 1) % 2]);
+        }
+        MPI_Wait(&peticionTrozo[c % 2], MPI_STATUS_IGNORE);
+
+        int filasTrozo = inicioTrozo[c + 1] - inicioTrozo[c];
+        double tInicio = MPI_Wtime();
+        productoBloque(&bloque[(long) inicioTrozo[c] * n], n, xLocal, &destino[(long) inicioTrozo[c] * k], filasTrozo, n, k);
+        anotaCalculo(tInicio, MPI_Wtime(), (double) filasTrozo * n * sizeof(S));
+        tCalculo += MPI_Wtime() - tInicio;
+
+        peticionResultado[c] = MPI_REQUEST_NULL;
+        if (!config.yRepartido) {
+            MPI_Igatherv(&destino[(long) inicioTrozo[c] * k], filasTrozo, MPI_POSICION,
+                    y, &cuentasTrozo[c * P], &desplTrozo[c * P], MPI_POSICION,
+                    0, comunicador, &peticionResultado[c]);
+        }
+    }
+    if (config.abft) {
+        abft[0]++;
+        abft[1] += compruebaControl(filaControl, n, xLocal, destino, alto, k);
+    }
+    MPI_Waitall(segmentos, &peticionResultado[0], MPI_STATUSES_IGNORE);
+    repartoPendiente = false;
+    pendiente = NULL;
+    anotaFase(FASE_REPARTO_A, tInicioReparto);
+}
+
+/*
+ Producto del bloque local por xLocal. Con CARGA_FLUJO el bloque se lee panel a
+ panel: mientras se multiplica el panel p se lee el p + 1 en la otra mitad de
+ 'bloque', y al terminar se empieza a leer el primero del siguiente producto,
+ que llega mientras se recoge y y se reparte el siguiente x. Si el bloque cabe
+ en los dos paneles, se lee una sola vez.
+ */
+template <typename T, typename S>
+void MatrizDistribuida<T, S>::productoLocal(T *destino) {
+    const int k = config.k;
+    if (config.carga != CARGA_FLUJO) {
+        productoBloque(bloque, ld, xLocal, destino, alto, ancho, k);
+        return;
+    }
+    for (long p = 0; p < paneles; p++) {
+        if (p + 1 < paneles) {
+            leePanel(p + 1);
+        }
+        const S *panel = esperaPanel(p);
+        productoBloque(panel, ancho, xLocal, &destino[p * filasPanel * k], min(filasPanel, alto - p * filasPanel), ancho, k);
+    }
+    if (paneles > 0) {
+        leePanel(0);
+    }
+}
+
+// Empieza a leer el panel p en su mitad de 'bloque', si no esta ya (o se esta leyendo) alli
+template <typename T, typename S>
+void MatrizDistribuida<T, S>::leePanel(long p) {
+    int mitad = p % 2;
+    if (panelLeido[mitad] == p) return;
+    esperaLectura(mitad);
+    long filasLeidas = min(filasPanel, alto - p * filasPanel);
+    MPI_File_iread_at(ficheroFlujo, // Fichero con la vista del bloque de este proceso
+            (MPI_Offset) p * filasPanel * ancho, // Primer elemento del panel dentro de la vista
+            &bloque[mitad * filasPanel * ancho], // Mitad de 'bloque' en la que se lee
+            filasLeidas, // Numero de filas del panel
+            MPI_FILA_PANEL, // Tipo de dato que se lee (una fila del bloque)
+            &lecturaPanel[mitad]); // Peticion que se completa al terminar la lectura
+    panelLeido[mitad] = p;
+    bytesFlujo += filasLeidas * ancho * (long) sizeof(S);
+}
+
+/*
+ Espera la lectura pendiente en la mitad 'mitad' de 'bloque' y comprueba que se han leido todas las filas
+ del panel. Cada proceso lee por su cuenta, asi que si falta alguna se aborta la ejecucion de todos
+ */
+template <typename T, typename S>
+void MatrizDistribuida<T, S>::esperaLectura(int mitad) {
+    if (lecturaPanel[mitad] == MPI_REQUEST_NULL) return;
+    MPI_Status estado;
+    MPI_Wait(&lecturaPanel[mitad], &estado);
+    int filasRecibidas;
+    MPI_Get_count(&estado, MPI_FILA_PANEL, &filasRecibidas);
+    long filasLeidas = min(filasPanel, alto - panelLeido[mitad] * filasPanel);
+    if (filasRecibidas != filasLeidas) {
+        fprintf(stderr, "Error: el proceso %d solo ha leido %d de las %ld filas del panel %ld de %s\n", id,
+                filasRecibidas == MPI_UNDEFINED ? 0 : filasRecibidas, filasLeidas, panelLeido[mitad], config.fichero.c_str());
+        MPI_Abort(comunicador, 1);
+    }
+}
+
+template <typename T, typename S>
+const S *MatrizDistribuida<T, S>::esperaPanel(long p) {
+    leePanel(p);
+    esperaLectura(p % 2);
+    return &bloque[(p % 2) * filasPanel * ancho];
+}
+
+template <typename T, typename S>
+void MatrizDistribuida<T, S>::ejecutaBloques(const T *x, T *y) {
+    const int k = config.k;
+
+    double tFase = MPI_Wtime();
+    if (!config.yRepartido) {
+        if (filaP == 0) {
+            // A cada columna de procesos su trozo de x
+            MPI_Scatterv(x, &cuentasX[0], &desplX[0], MPI_POSICION, xLocal, ancho, MPI_POSICION, 0, filas);
+        }
+        if (config.persistentes) {
+            ejecutaColectiva(difusionX);
+        } else if (config.topologia) {
+            difundeNiveles(xLocal, ancho, MPI_POSICION, nivelesColumnas); // Primero a un proceso de cada nodo de la columna
+        } else {
+            MPI_Bcast(xLocal, ancho, MPI_POSICION, 0, columnas); // El proceso de la primera fila reparte al resto de su columna el trozo de vector x recibido
+        }
+    } else {
+        // Cada proceso aporta su trozo de x y recibe los del resto de su columna
+        MPI_Allgatherv(x, // Trozo de x de este proceso
+                posicionesY, // Posiciones que aporta
+                MPI_POSICION, // Tipo del dato que se envia
+                xLocal, // Trozo de x de esta columna de la malla
+                &cuentasXColumna[0], // Posiciones que aporta cada proceso de la columna
+                &desplXColumna[0], // Posicion del trozo de cada uno dentro del de la columna
+                MPI_POSICION, // Tipo del dato que se intercambia
+                columnas); // Canal de comunicacion (Columnas)
+    }
+    anotaFase(FASE_REPARTO_X, tFase);
+
+    // Hacemos una barrera para asegurar que todas los procesos comiencen la ejecucion
+    // a la vez, para tener mejor control del tiempo empleado
+    MPI_Barrier(comunicador);
+    double tInicio = MPI_Wtime();
+
+    productoLocal(subFinal);
+    if (config.abft) {
+        abft[0]++;
+        abft[1] += compruebaControl(filaControl, ancho, xLocal, subFinal, alto, k);
+    }
+    // El calculo de cada proceso se anota antes de la barrera, que se anota aparte como espera
+    anotaCalculo(tInicio, MPI_Wtime(), (double) alto * ancho * sizeof(S));
+
+    MPI_Barrier(comunicador);
+    tCalculo = MPI_Wtime() - tInicio;
+    anotaFase(FASE_CALCULO, tInicio);
+
+    tFase = MPI_Wtime();
+    if (config.distribucion == DISTRIBUCION_COLUMNAS && !config.yRepartido) {
+        // Cada proceso se queda con la suma de su trozo de y y el proceso 0 los recoge
+        MPI_Reduce_scatter(subFinal, // Valor local de datos (y completo)
+                yFila, // Trozo reducido de este proceso
+                &cuentasReduccion[0], // Elementos del trozo de cada proceso
+                tipoMPI<T>(), // Tipo de dato que vamos a reducir
+                MPI_SUM, // Operacion que aplicaremos
+                comunicador); // Comunicador de la matriz
+        anotaFase(FASE_REDUCCION, tFase);
+
+        tFase = MPI_Wtime();
+        MPI_Gatherv(yFila, // Trozo de y de este proceso
+                posicionesY, // Numero de posiciones (de los k vectores) que se envian
+                MPI_POSICION, // Tipo del dato que se envia
+                y, // Vector en el que se recolectan los datos
+                &cuentasTrozoY[0], // Posiciones de cada proceso
+                &desplTrozoY[0], // Primera posicion de cada proceso
+                MPI_POSICION, // Tipo del dato que se recibira
+                0, // proceso que va a recibir los datos
+                comunicador); // Comunicador de la matriz
+        anotaFase(FASE_RECOGIDA, tFase);
+    } else if (!config.yRepartido) {
+        // El primer proceso de cada fila reduce la de su fila (el proceso 0 directamente en y, salvo
+        // con la reduccion persistente, que tiene su destino fijo en yFila)
+        if (config.persistentes) {
+            ejecutaColectiva(reduccionY);
+        } else if (config.topologia) {
+            // Primero dentro de cada nodo de la fila y despues entre nodos
+            reduceNiveles(subFinal, id == 0 ? y : yFila, yParcial, alto * k, tipoMPI<T>(), MPI_SUM, nivelesFilas);
+        } else {
+            reduceGrande(subFinal, // Valor local de datos
+                        id == 0 ? y : yFila, // Dato sobre el que vamos a reducir el resto
+                        alto * k, // Numero de datos que vamos a reducir (los k vectores)
+                        tipoMPI<T>(), // Tipo de dato que vamos a reducir
+                        MPI_SUM, // Operacion que aplicaremos
+                        0, // proceso que va a recibir el dato reducido (primero de la fila)
+                        filas); // Canal de comunicacion (Filas)
+        }
+        anotaFase(FASE_REDUCCION, tFase);
+
+        // Los procesos que no estan en la primera columna anotan una recogida de duracion cero
+        tFase = MPI_Wtime();
+        if (columnaP == 0) {
+            MPI_Gatherv(id == 0 && yFila == NULL ? MPI_IN_PLACE : yFila, // Dato que envia cada proceso (el del proceso 0 puede estar ya en su sitio)
+                    alto, // Numero de posiciones (de los k vectores) que se envian
+                    MPI_POSICION, // Tipo del dato que se envia
+                    y, // Vector en el que se recolectan los datos
+                    &cuentasY[0], // Numero de posiciones que se esperan recibir de cada fila
+                    &desplY[0], // Posicion del trozo de cada fila
+                    MPI_POSICION, // Tipo del dato que se recibira
+                    0, // proceso que va a recibir los datos
+                    columnas); // Canal de comunicacion (Primera columna)
+        }
+        anotaFase(FASE_RECOGIDA, tFase);
+    } else {
+        // Cada proceso recibe su trozo de y ya reducido, en la columna que lo usara como x
+        MPI_Reduce_scatter(subFinal, // Valor local de datos
+                y, // Trozo reducido de este proceso
+                &cuentasReduccion[0], // Elementos del trozo de cada proceso de la fila
+                tipoMPI<T>(), // Tipo de dato que vamos a reducir
+                MPI_SUM, // Operacion que aplicaremos
+                filas); // Canal de comunicacion (Filas)
+        anotaFase(FASE_REDUCCION, tFase);
+    }
+}
+
+template <typename T, typename S>
+void MatrizDistribuida<T, S>::recogeY(const T *trozo, T *y) {
+    MPI_Gatherv(trozo, posicionesY, MPI_POSICION, y, &cuentasTrozoY[0], &desplTrozoY[0], MPI_POSICION, 0, comunicador);
+}
+
+/*
+ Cada proceso aporta w^T x con su bloque y su trozo de x, y r^T y con las
+ posiciones de y que tiene: su trozo con yRepartido o, si y se ha recogido, todo
+ y en el proceso 0 (el mismo vector que devuelve ejecuta()).
+ */
+template <typename T, typename S>
+long MatrizDistribuida<T, S>::compruebaFreivalds(unsigned long long semilla, const T *y) {
+    vector<typename TipoControl<T>::tipo> &w = wFreivalds;
+    if (!hayProyeccion || semillaFreivalds != semilla) {
+        if (config.carga == CARGA_FLUJO) {
+            // Una pasada por los paneles, sumando la proyeccion de cada uno
+            vector<typename TipoControl<T>::tipo> wPanel;
+            w.assign(ancho, 0);
+            for (long p = 0; p < paneles; p++) {
+                if (p + 1 < paneles) {
+                    leePanel(p + 1);
+                }
+                proyeccionFreivalds<T>(semilla, esperaPanel(p), ancho, fila0 + p * filasPanel, min(filasPanel, alto - p * filasPanel),
+                        ancho, wPanel);
+                for (long j = 0; j < ancho; j++) {
+                    w[j] += wPanel[j];
+                }
+            }
+        } else {
+            proyeccionFreivalds<T>(semilla, bloque, ld, fila0, alto, ancho, w);
+        }
+        semillaFreivalds = semilla;
+        hayProyeccion = true;
+    }
+    if (config.yRepartido) {
+        return ::compruebaFreivalds(semilla, w, xLocal, config.k, y, inicioY, posicionesY, comunicador);
+    }
+    return ::compruebaFreivalds(semilla, w, xLocal, config.k, y, 0, id == 0 ? config.n : 0, comunicador);
+}
+
+template class MatrizDistribuida<int, short>;
+template class MatrizDistribuida<int, int>;
+template class MatrizDistribuida<long, short>;
+template class MatrizDistribuida<long, int>;
+template class MatrizDistribuida<long, long>;
+template class MatrizDistribuida<float, short>;
+template class MatrizDistribuida<float, float>;
+template class MatrizDistribuida<double, short>;
+template class MatrizDistribuida<double, int>;
+template class MatrizDistribuida<double, float>;
+template class MatrizDistribuida<double, double>;
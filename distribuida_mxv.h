@@ -0,0 +1,313 @@
+/*
+ ============================================================================
+ Name        : distribuida_mxv.h
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Biblioteca del producto matriz-vector denso repartido (libmxv):
+    la clase MatrizDistribuida, con la que programa_mxv.h hace el producto
+    denso de matriz_x_vector.cpp (distribucion por filas, por columnas o por
+    submatrices) y de bidimensional_matriz_x_vector.cpp (por submatrices), y
+    que se puede llamar tambien desde otros programas.
+
+ El uso se separa en tres pasos:
+ - planifica(): una sola vez por configuracion (n, k, distribucion, carga de
+   la matriz y opciones). Reparte las filas o forma la malla, crea los
+   comunicadores de filas y columnas de la malla (con topologia, colocada por
+   nodos con MPI_Cart_create; o los de nodo con xCompartido), los tipos
+   derivados, todas las cuentas y desplazamientos de las colectivas, y
+   reserva el bloque de A y los buffers locales. Con persistentes prepara
+   tambien la difusion de x y la reduccion de y de cada producto como
+   colectivas persistentes (colectivas_mxv.h).
+ - reparte(A): carga el bloque de A de cada proceso, desde la matriz completa
+   del proceso 0 (CARGA_RAIZ, el resto pasa NULL), generandolo con la semilla
+   o leyendolo del fichero. Se puede repetir sin volver a planificar. Con
+   CARGA_FLUJO el bloque no se carga: cada producto lo lee del fichero por
+   paneles de filasPanel filas, con dos paneles en memoria (el que se
+   multiplica y el siguiente, que se lee a la vez con MPI_File_iread_at).
+ - ejecuta(x, y): y = A x para los k vectores. Solo hay comunicaciones y
+   calculo, sin MPI_Comm_split, sin new[] y sin tipos nuevos, asi que se puede
+   llamar en cada iteracion de un metodo iterativo.
+
+ Los vectores se guardan por posiciones, con los k valores de cada posicion
+ seguidos. Sin yRepartido, x solo hace falta en el proceso 0 (n posiciones) y
+ y se recoge en el. Con yRepartido cada proceso pasa su trozo de x y recibe el
+ mismo trozo de y (posiciones() posiciones a partir de primeraPosicion()), de
+ modo que el resultado se puede usar directamente como el siguiente x.
+
+ Distribuciones:
+ - DISTRIBUCION_FILAS: bloques de filas consecutivas de tamaños que difieren
+   como mucho en una fila. En nodos de distinta potencia, 'pesos' da la
+   capacidad relativa de cada proceso y las filas se reparten en proporcion;
+   con 'calibrar' se mide antes con una ejecucion corta del nucleo.
+ - DISTRIBUCION_COLUMNAS: cada proceso recibe su trozo de x con MPI_Scatterv,
+   calcula su contribucion a todo y, y MPI_Reduce_scatter deja a cada proceso
+   la suma de su trozo.
+ - DISTRIBUCION_BLOQUES: malla de R x C procesos con R bloques de filas y C de
+   columnas (de tamaños que difieren como mucho en uno, asi que n no tiene que
+   ser multiplo de R ni de C). x se reparte por la primera fila de la malla y
+   se difunde por columnas, y y se reduce por filas y se recoge por la primera
+   columna. Sin topologia la malla sigue el orden de rango (MPI_Comm_split) y
+   las colectivas de filas y columnas cruzan la red aunque los procesos
+   compartan nodo.
+ Columnas y submatrices no admiten pesos, calibrar, segmentos ni xCompartido.
+
+ Los tamaños e indices son de 64 bits, asi que n puede pasar de 46340: las
+ filas completas se reparten como un tipo derivado de n elementos, las
+ submatrices como un tipo MPI_BLOQUE cada una (directamente desde la matriz
+ del proceso 0, sin copiarlas a una matriz reordenada) y los vectores en
+ posiciones de k elementos, de modo que las cuentas int de MPI cuentan filas o
+ posiciones y no elementos. Con k > 1 cada elemento de A se lee una sola vez
+ para los k vectores y x e y viajan en un solo mensaje para todo el bloque.
+
+ Con 'segmentos' C > 1 el reparto de las filas se hace en C trozos con
+ MPI_Iscatterv y se solapa con el primer producto: mientras llega el trozo c+1
+ se calcula el c y su resultado vuelve con MPI_Igatherv. Con CARGA_GENERADA no
+ hay reparto de A (cada proceso genera su bloque, con memoria O(n^2 / P)) y
+ los segmentos no tienen efecto.
+
+ yRepartido evita que todo el vector pase dos veces por el proceso 0 en cada
+ iteracion. Con DISTRIBUCION_BLOQUES la reduccion por filas es un
+ MPI_Reduce_scatter en el que el proceso (f, c) se queda con las filas del
+ bloque f que son columnas del bloque c (trozoY en distribuida_mxv.cpp), un
+ trozo del siguiente x que ya esta en la columna de la malla que lo usa, y
+ los procesos de cada columna se intercambian sus trozos con MPI_Allgatherv;
+ con una malla cuadrada los trozos no vacios son los de la diagonal. Las
+ colectivas persistentes no se usan con yRepartido.
+
+ La biblioteca se compila como estatica y como dinamica (Makefile) con las
+ combinaciones de tipo de elemento T y de almacenamiento S que admite
+ almacenValido, instanciadas en distribuida_mxv.cpp.
+ ============================================================================
+ */
+
+#ifndef DISTRIBUIDA_MXV_H
+#define DISTRIBUIDA_MXV_H
+
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+#include "colectivas_mxv.h"
+#include "fases_mxv.h"
+#include "fichero_matriz.h"
+#include "nodo_mxv.h"
+#include "verificacion_mxv.h"
+
+enum DistribucionMatriz {
+    DISTRIBUCION_FILAS, // Bloques de filas consecutivas, uno por proceso
+    DISTRIBUCION_BLOQUES, // Submatrices de una malla de procesos
+    DISTRIBUCION_COLUMNAS // Bloques de columnas consecutivas (malla de 1 x P), con y reducido por MPI_Reduce_scatter
+};
+
+enum CargaMatriz {
+    CARGA_RAIZ, // El proceso 0 tiene la matriz completa y reparte los bloques
+    CARGA_GENERADA, // Cada proceso genera su bloque con la semilla (generador_mxv.h)
+    CARGA_FICHERO, // Cada proceso lee su bloque del fichero con MPI-IO
+    CARGA_PROYECCION, // Cada proceso usa su bloque del fichero proyectado en memoria (mmap)
+    CARGA_FLUJO // Cada proceso lee su bloque del fichero por paneles en cada producto (fuera de memoria)
+};
+
+struct ConfiguracionMxv {
+    ConfiguracionMxv() : n(0), k(1), distribucion(DISTRIBUCION_FILAS), filasMalla(0), columnasMalla(0), calibrar(false),
+            carga(CARGA_RAIZ), semilla(0), segmentos(1), comprimir(false), abft(false), yRepartido(false), xCompartido(false),
+            persistentes(false), filasPanel(0), topologia(false), noNulosFila(0) {}
+
+    long n; // Dimension de la matriz
+    int k; // Numero de vectores que se multiplican a la vez
+    DistribucionMatriz distribucion;
+    int filasMalla; // Malla de procesos con DISTRIBUCION_BLOQUES (0 = la elige MPI_Dims_create)
+    int columnasMalla;
+    std::vector<double> pesos; // Capacidad relativa de cada proceso con DISTRIBUCION_FILAS (vacio = todos iguales)
+    bool calibrar; // Medir la capacidad de cada proceso en planifica() en lugar de usar 'pesos'
+    CargaMatriz carga;
+    unsigned long long semilla; // Semilla de la matriz con CARGA_GENERADA
+    std::string fichero; // Fichero de la matriz con CARGA_FICHERO, CARGA_PROYECCION y CARGA_FLUJO
+    int segmentos; // Trozos del reparto solapado con el primer producto (DISTRIBUCION_FILAS y CARGA_RAIZ)
+    bool comprimir; // Repartir los bloques comprimidos (compresion_mxv.h, CARGA_RAIZ y almacenamiento entero)
+    bool abft; // Comprobar cada producto local con la fila de control de su bloque
+    bool yRepartido; // x e y son el trozo de cada proceso, sin pasar por el proceso 0
+    bool xCompartido; // Una copia de x e y por nodo (DISTRIBUCION_FILAS, sin yRepartido)
+    bool persistentes; // Difusion de x y reduccion de y con colectivas persistentes (sin yRepartido)
+    long filasPanel; // Filas de cada panel con CARGA_FLUJO
+    bool topologia; // DISTRIBUCION_BLOQUES: malla colocada por nodos y reduccion y difusion en dos niveles (nodo_mxv.h)
+    long noNulosFila; // No nulos por fila de media de la matriz dispersa (MatrizDispersa, dispersa_mxv.h)
+};
+
+/*
+ Matriz densa de n x n elementos de tipo T, guardada en el tipo S, repartida
+ entre los procesos de un comunicador. Todos los metodos salvo las consultas
+ son colectivos.
+ */
+template <typename T, typename S = T>
+class MatrizDistribuida {
+public:
+    explicit MatrizDistribuida(MPI_Comm comunicador);
+    ~MatrizDistribuida();
+
+    void planifica(const ConfiguracionMxv &configuracion);
+
+    /*
+     Compresion y filas de control de la matriz completa del proceso 0
+     (CARGA_RAIZ): se hacen una vez por matriz. reparte() las hace si 'A' no es
+     la ultima matriz preparada; llamarla antes deja ese coste fuera del reparto.
+     */
+    void prepara(const S *A);
+
+    /*
+     Carga el bloque de A de cada proceso. Con reparto segmentado la matriz se
+     envia dentro del siguiente ejecuta(), asi que 'A' debe seguir existiendo.
+     */
+    void reparte(const S *A);
+
+    void ejecuta(const T *x, T *y);
+
+    /*
+     Iteracion de potencia con el bloque de A residente: hasta 'iteraciones'
+     productos, reescalando cada y al rango de x (utilidades_mxv.h) y usandolo
+     como el siguiente x, hasta que la maxima diferencia entre dos vectores
+     consecutivos sea <= 'tolerancia'. Sin yRepartido reescala el proceso 0 y
+     difunde si se sigue; con yRepartido cada proceso reescala su trozo con el
+     maximo de todo el vector. 'x' solo se sustituye si se sigue, asi que al
+     terminar 'x' e 'y' son la entrada y la salida del ultimo producto (las que
+     se comprueban). Devuelve el numero de productos realizados.
+     */
+    int itera(T *x, T *y, int iteraciones, double tolerancia);
+
+    // Con yRepartido, reune en el proceso 0 el 'trozo' de y de cada proceso
+    void recogeY(const T *trozo, T *y);
+
+    /*
+     Comprobacion de Freivalds (verificacion_mxv.h) del ultimo producto, con el
+     'y' que se paso a ejecuta(). La proyeccion w = r^T A se calcula la primera
+     vez que se comprueba con cada semilla despues de reparte(). Devuelve en el
+     proceso 0 el numero de vectores incorrectos.
+     */
+    long compruebaFreivalds(unsigned long long semilla, const T *y);
+
+    // Las fases de cada reparto y producto se anotan en 'medidor' (NULL = ninguno)
+    void anotaFases(MedidorFases *medidor) {
+        fases = medidor;
+    }
+
+    int filasMalla() const { return filasP; }
+    int columnasMalla() const { return columnasP; }
+    const long *primeraFila() const { return &inicioFilas[0]; } // filasMalla() + 1 posiciones
+    const long *primeraColumna() const { return &inicioColumnas[0]; } // columnasMalla() + 1 posiciones
+    const std::vector<double> &pesos() const { return pesosFilas; }
+    long primeraPosicion() const { return inicioY; } // Trozo de x e y de este proceso con yRepartido
+    long posiciones() const { return posicionesY; }
+    int nodos() const { return memoria.nodos; }
+    long bytesLeidos() const { return bytesFlujo; } // Del fichero con CARGA_FLUJO, en este proceso y desde planifica()
+    long bytesComprimidos() const { return palabrasTotales * (long) sizeof(unsigned long long); } // En el proceso 0
+    double tiempoCalculo() const { return tCalculo; } // Del ultimo ejecuta(), entre las barreras que lo rodean
+    double tiempoIteraciones() const { return tIteraciones; } // Suma de tiempoCalculo() en el ultimo itera()
+    long productosComprobados() const { return abft[0]; } // Productos locales comprobados con la fila de control
+    long fallosAbft() const { return abft[1]; }
+
+private:
+    MatrizDistribuida(const MatrizDistribuida &); // Sin copia: los comunicadores y buffers son propios
+    MatrizDistribuida &operator=(const MatrizDistribuida &);
+
+    void libera();
+    void ejecutaFilas(const T *x, T *y);
+    void ejecutaBloques(const T *x, T *y);
+    void ejecutaSegmentado(T *destino, T *y, double tInicio);
+    void productoLocal(T *destino);
+    void leePanel(long p);
+    void esperaLectura(int mitad);
+    const S *esperaPanel(long p);
+
+    void anotaFase(Fase fase, double inicio) {
+        if (fases != NULL) {
+            fases->anota(fase, MPI_Wtime() - inicio);
+        }
+    }
+
+    MPI_Comm comunicador;
+    int P, id;
+    ConfiguracionMxv config;
+    bool planificada;
+
+    // Reparto: malla de filasP x columnasP procesos (columnasP = 1 con DISTRIBUCION_FILAS)
+    int filasP, columnasP, filaP, columnaP;
+    std::vector<int> celda; // Celda de la malla (fila * columnasP + columna) de cada proceso, en orden de rango
+    std::vector<long> inicioFilas, inicioColumnas;
+    std::vector<double> pesosFilas;
+    long fila0, alto, columna0, ancho; // Bloque de este proceso
+    long inicioY, posicionesY; // Trozo de x e y de este proceso con yRepartido
+    std::vector<int> cuentasTrozoY, desplTrozoY; // Trozos de y de todos los procesos, en posiciones
+
+    // Bloque local de A
+    S *bloque;
+    long ld;
+    ProyeccionMatriz proyeccion;
+
+    // Lectura por paneles con CARGA_FLUJO: 'bloque' tiene dos paneles, el que se multiplica y el siguiente
+    MPI_File ficheroFlujo;
+    MPI_Datatype MPI_FILA_PANEL; // Una fila del bloque local
+    long filasPanel, paneles;
+    MPI_Request lecturaPanel[2];
+    long panelLeido[2]; // Panel que hay (o se esta leyendo) en cada mitad de 'bloque' (-1 = ninguno)
+    long bytesFlujo;
+
+    // Tipos y comunicadores
+    MPI_Datatype MPI_POSICION; // Los k valores de una posicion de x o y
+    MPI_Datatype MPI_FILA; // Una fila completa de A (DISTRIBUCION_FILAS)
+    MPI_Comm filas, columnas; // Filas y columnas de la malla (DISTRIBUCION_BLOQUES)
+    NivelesNodo nivelesFilas, nivelesColumnas; // Con topologia, los dos niveles de cada fila y de cada columna
+    std::vector<int> cuentasX, desplX, cuentasY, desplY; // Trozos de x por columnas y de y por filas de la malla
+    std::vector<int> cuentasReduccion, cuentasXColumna, desplXColumna; // Reduce_scatter y Allgatherv con yRepartido
+    std::vector<long> displenv; // Primer elemento del bloque de cada proceso dentro de A
+    std::vector<MPI_Datatype> tiposBloque; // Un tipo por tamaño de submatriz (hasta cuatro)...
+    std::vector<std::vector<long> > cuentasBloque; // ...y los procesos que lo reciben
+
+    // Vectores locales
+    T *xLocal; // x de la columna de la malla (con DISTRIBUCION_FILAS, completo)
+    T *subFinal; // Resultado local (con xCompartido, dentro del y del nodo)
+    T *yFila; // Reduccion de la fila de la malla en su primer proceso (salvo en el proceso 0)
+    T *yNodo; // y del nodo con xCompartido
+    T *yParcial; // Con topologia, reduccion de la fila dentro del nodo en su lider
+    MemoriaNodo memoria;
+    RecogidaNodos recogida;
+    ColectivaPersistente difusionX, reduccionY; // Con persistentes, preparadas en planifica()
+
+    // Reparto segmentado (segmentos > 1)
+    int segmentos;
+    std::vector<int> cuentasTrozo, desplTrozo, inicioTrozo;
+    std::vector<MPI_Request> peticionResultado;
+    bool repartoPendiente; // El bloque se reparte dentro del siguiente ejecuta() (en todos los procesos)...
+    const S *pendiente; // ...desde esta matriz (en el proceso 0)
+
+    // Compresion y filas de control de la matriz completa (CARGA_RAIZ)
+    const S *preparada;
+    unsigned long long *comprimida, *miComprimido;
+    std::vector<long> palabrasBloque, desplBloque;
+    long misPalabras, capacidadComprimido, palabrasTotales;
+    T *controles, *filaControl;
+    std::vector<long> cuentasControl, desplControl;
+    long abft[2];
+
+    // Proyeccion de Freivalds del bloque local, valida hasta el siguiente reparto de A
+    std::vector<typename TipoControl<T>::tipo> wFreivalds;
+    unsigned long long semillaFreivalds;
+    bool hayProyeccion;
+
+    MedidorFases *fases;
+    double tCalculo, tIteraciones;
+};
+
+// Combinaciones instanciadas en la biblioteca (las de almacenValido)
+extern template class MatrizDistribuida<int, short>;
+extern template class MatrizDistribuida<int, int>;
+extern template class MatrizDistribuida<long, short>;
+extern template class MatrizDistribuida<long, int>;
+extern template class MatrizDistribuida<long, long>;
+extern template class MatrizDistribuida<float, short>;
+extern template class MatrizDistribuida<float, float>;
+extern template class MatrizDistribuida<double, short>;
+extern template class MatrizDistribuida<double, int>;
+extern template class MatrizDistribuida<double, float>;
+extern template class MatrizDistribuida<double, double>;
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ ============================================================================
+ Name        : fases_mxv.h
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Medida del tiempo de cada fase del producto (reparto de A,
+    reparto de x, calculo, reduccion y recogida de y) para
+    matriz_x_vector.cpp y bidimensional_matriz_x_vector.cpp.
+
+ Cada proceso anota una muestra por fase y por producto (el reparto de A, una
+ por repeticion). Al terminar, cada muestra se sustituye por la del proceso mas
+ lento (el que marca el ritmo) y el proceso 0 calcula el minimo, la mediana y el
+ percentil 95, los muestra y, si se pide, los añade a un fichero CSV o JSON
+ (una linea por fase y ejecucion, JSON Lines). bench_mxv.sh usa estos ficheros
+ para barrer n, P, tipo de dato y descomposicion. La fase de reduccion es la
+ de y por filas de la malla, o con y repartido el MPI_Allreduce del reescalado.
+ ============================================================================
+ */
+
+#ifndef FASES_MXV_H
+#define FASES_MXV_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+enum Fase { FASE_REPARTO_A, FASE_REPARTO_X, FASE_CALCULO, FASE_REDUCCION, FASE_RECOGIDA, NUMERO_FASES };
+
+inline const char *nombreFase(int fase) {
+    switch (fase) {
+        case FASE_REPARTO_A: return "reparto_A";
+        case FASE_REPARTO_X: return "reparto_x";
+        case FASE_CALCULO: return "calculo";
+        case FASE_REDUCCION: return "reduccion";
+        default: return "recogida";
+    }
+}
+
+// Datos de la ejecucion que identifican cada linea de los ficheros de resultados
+struct DescripcionEjecucion {
+    std::string programa; // "1d", "2d", "1d_disperso"...
+    long n;
+    int procesos;
+    int hilos;
+    std::string tipo;
+    int k;
+};
+
+class MedidorFases {
+public:
+    MedidorFases() : activo(true) {}
+
+    // Las repeticiones de calentamiento se ejecutan con el medidor inactivo
+    void activa(bool valor) {
+        activo = valor;
+    }
+
+    void anota(Fase fase, double segundos) {
+        if (activo) {
+            muestras[fase].push_back(segundos);
+        }
+    }
+
+    /*
+     Resume las muestras de todos los procesos: se queda con el maximo de cada
+     muestra y en el proceso 0 escribe minimo, mediana y percentil 95 de cada fase
+     por pantalla y en los ficheros 'csv' y 'json' (si no son vacios). Todos los
+     procesos deben tener el mismo numero de muestras de cada fase.
+     */
+    void resume(const DescripcionEjecucion &ejecucion, const std::string &csv, const std::string &json, MPI_Comm comunicador) {
+        int id;
+        MPI_Comm_rank(comunicador, &id);
+        FILE *ficheroCsv = NULL, *ficheroJson = NULL;
+        if (id == 0) {
+            std::cout << "Fase\t\tmuestras\tminimo (s)\tmediana (s)\tp95 (s)" << std::endl;
+            if (!csv.empty()) {
+                ficheroCsv = fopen(csv.c_str(), "a");
+                if (ficheroCsv != NULL && fseek(ficheroCsv, 0, SEEK_END) == 0 && ftell(ficheroCsv) == 0) {
+                    fprintf(ficheroCsv, "programa,n,procesos,hilos,tipo,k,fase,muestras,minimo,mediana,p95\n");
+                }
+            }
+            if (!json.empty()) {
+                ficheroJson = fopen(json.c_str(), "a");
+            }
+        }
+        for (int fase = 0; fase < NUMERO_FASES; fase++) {
+            std::vector<double> &locales = muestras[fase];
+            std::vector<double> maximos(locales.size() + 1);
+            if (locales.empty()) continue;
+            MPI_Reduce(&locales[0], &maximos[0], locales.size(), MPI_DOUBLE, MPI_MAX, 0, comunicador);
+            if (id != 0) continue;
+
+            maximos.pop_back();
+            std::sort(maximos.begin(), maximos.end());
+            double minimo = maximos[0];
+            double mediana = percentil(maximos, 0.5);
+            double p95 = percentil(maximos, 0.95);
+            std::cout << nombreFase(fase) << "\t" << maximos.size() << "\t\t" << minimo << "\t" << mediana << "\t" << p95 << std::endl;
+            if (ficheroCsv != NULL) {
+                fprintf(ficheroCsv, "%s,%ld,%d,%d,%s,%d,%s,%zu,%.9g,%.9g,%.9g\n", ejecucion.programa.c_str(), ejecucion.n,
+                        ejecucion.procesos, ejecucion.hilos, ejecucion.tipo.c_str(), ejecucion.k, nombreFase(fase),
+                        maximos.size(), minimo, mediana, p95);
+            }
+            if (ficheroJson != NULL) {
+                fprintf(ficheroJson, "{\"programa\": \"%s\", \"n\": %ld, \"procesos\": %d, \"hilos\": %d, \"tipo\": \"%s\", \"k\": %d, "
+                        "\"fase\": \"%s\", \"muestras\": %zu, \"minimo\": %.9g, \"mediana\": %.9g, \"p95\": %.9g}\n",
+                        ejecucion.programa.c_str(), ejecucion.n, ejecucion.procesos, ejecucion.hilos, ejecucion.tipo.c_str(),
+                        ejecucion.k, nombreFase(fase), maximos.size(), minimo, mediana, p95);
+            }
+        }
+        if (ficheroCsv != NULL) {
+            fclose(ficheroCsv);
+        }
+        if (ficheroJson != NULL) {
+            fclose(ficheroJson);
+        }
+    }
+
+private:
+    // Percentil 'p' (entre 0 y 1) de unas muestras ordenadas, por el rango mas cercano
+    static double percentil(const std::vector<double> &ordenadas, double p) {
+        size_t posicion = (size_t) std::ceil(p * ordenadas.size());
+        return ordenadas[std::min(ordenadas.size(), std::max((size_t) 1, posicion)) - 1];
+    }
+
+    bool activo;
+    std::vector<double> muestras[NUMERO_FASES];
+};
+
+#endif
@@ -0,0 +1,226 @@
+/*
+ ============================================================================
+ Name        : fichero_matriz.h
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Formato binario de la matriz y su lectura en paralelo.
+
+ El fichero empieza con una cabecera de 32 bytes (CabeceraMatriz): la marca
+ "MXV1", el tipo de dato (TipoDato de utilidades_mxv.h), la disposicion de los
+ datos y el numero de filas y columnas. Detras van los elementos por filas, en
+ la representacion nativa de la maquina. genera_matriz.cpp crea ficheros en
+ este formato.
+
+ Cada proceso lee su bloque de filas o su submatriz con MPI-IO colectivo
+ (MPI_File_read_at_all) sobre una vista del fichero construida con
+ MPI_Type_vector, el mismo tipo MPI_BLOQUE que usa el programa bidimensional.
+ En un solo nodo, proyectaMatriz() mapea el fichero en memoria y los procesos
+ usan sus filas directamente, sin copiarlas. abreBloqueMPIIO() deja abierta esa
+ misma vista para leer el bloque por paneles (lectura fuera de memoria).
+ ============================================================================
+ */
+
+#ifndef FICHERO_MATRIZ_H
+#define FICHERO_MATRIZ_H
+
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <mpi.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "generador_mxv.h"
+#include "utilidades_mxv.h"
+
+enum DisposicionMatriz { DISPOSICION_FILAS = 0 };
+
+struct CabeceraMatriz {
+    char magico[4]; // "MXV1"
+    unsigned int tipo; // TipoDato de los elementos
+    unsigned int disposicion; // DisposicionMatriz
+    unsigned int reservado;
+    long long filas;
+    long long columnas;
+};
+
+const long BYTES_CABECERA = sizeof(CabeceraMatriz);
+
+inline void rellenaCabecera(CabeceraMatriz &cabecera, TipoDato tipo, long filas, long columnas) {
+    memset(&cabecera, 0, sizeof(cabecera));
+    memcpy(cabecera.magico, "MXV1", 4);
+    cabecera.tipo = tipo;
+    cabecera.disposicion = DISPOSICION_FILAS;
+    cabecera.filas = filas;
+    cabecera.columnas = columnas;
+}
+
+/*
+ Lee la cabecera y comprueba que el fichero tiene exactamente los bytes que
+ indica (cabecera y filas * columnas elementos): uno truncado daria resultados
+ sin sentido con MPI-IO y SIGBUS con la proyeccion en memoria.
+ */
+inline bool leeCabecera(const char *ruta, CabeceraMatriz &cabecera) {
+    FILE *fichero = fopen(ruta, "rb");
+    if (fichero == NULL) {
+        return false;
+    }
+    bool correcta = fread(&cabecera, sizeof(cabecera), 1, fichero) == 1
+            && memcmp(cabecera.magico, "MXV1", 4) == 0
+            && cabecera.tipo >= TIPO_INT32 && cabecera.tipo <= TIPO_DOUBLE
+            && cabecera.filas > 0 && cabecera.columnas > 0;
+    if (correcta) {
+        long long bytes = bytesTipoDato((TipoDato) cabecera.tipo);
+        correcta = cabecera.filas <= (LLONG_MAX - BYTES_CABECERA) / bytes / cabecera.columnas
+                && fseeko(fichero, 0, SEEK_END) == 0
+                && (long long) ftello(fichero) == BYTES_CABECERA + cabecera.filas * cabecera.columnas * bytes;
+    }
+    fclose(fichero);
+    return correcta;
+}
+
+/*
+ El proceso 0 lee la cabecera y la reparte al resto. Devuelve false en todos los
+ procesos si el fichero no existe, no tiene el formato esperado o no tiene el
+ tamaño que indica su cabecera.
+ */
+inline bool leeCabeceraMPI(const char *ruta, CabeceraMatriz &cabecera, MPI_Comm comunicador) {
+    int id, correcta = 0;
+    MPI_Comm_rank(comunicador, &id);
+    if (id == 0) {
+        correcta = leeCabecera(ruta, cabecera);
+    }
+    MPI_Bcast(&correcta, 1, MPI_INT, 0, comunicador);
+    MPI_Bcast(&cabecera, sizeof(cabecera), MPI_BYTE, 0, comunicador);
+    return correcta;
+}
+
+/*
+ Abre el fichero con la vista del bloque de filas [fila0, fila0 + filas) y
+ columnas [columna0, columna0 + columnas) de una matriz de 'columnasFichero'
+ columnas: la fila i del bloque empieza en el elemento i * columnas de la vista.
+ Todos los procesos de 'comunicador' deben llamarla (con su propio bloque).
+ */
+template <typename T>
+void abreBloqueMPIIO(const char *ruta, long columnasFichero, long fila0, long filas, long columna0, long columnas,
+        MPI_Comm comunicador, MPI_File &fichero) {
+    MPI_File_open(comunicador, ruta, MPI_MODE_RDONLY, MPI_INFO_NULL, &fichero);
+
+    MPI_Datatype MPI_BLOQUE; // El bloque del proceso dentro de la matriz completa
+    MPI_Type_vector(filas, columnas, columnasFichero, tipoMPI<T>(), &MPI_BLOQUE);
+    MPI_Type_commit(&MPI_BLOQUE);
+
+    MPI_Offset desplazamiento = BYTES_CABECERA + (MPI_Offset) (fila0 * columnasFichero + columna0) * sizeof(T);
+    MPI_File_set_view(fichero, desplazamiento, tipoMPI<T>(), MPI_BLOQUE, "native", MPI_INFO_NULL);
+    MPI_Type_free(&MPI_BLOQUE);
+}
+
+/*
+ Lectura colectiva del bloque de filas [fila0, fila0 + filas) y columnas
+ [columna0, columna0 + columnas) de una matriz de 'columnasFichero' columnas.
+ Todos los procesos de 'comunicador' deben llamarla (con su propio bloque).
+ */
+template <typename T>
+void leeBloqueMPIIO(const char *ruta, long columnasFichero, long fila0, long filas, long columna0, long columnas, T *destino, MPI_Comm comunicador) {
+    MPI_File fichero;
+    abreBloqueMPIIO<T>(ruta, columnasFichero, fila0, filas, columna0, columnas, comunicador, fichero);
+    // Se lee en filas del bloque para que la cuenta quepa en un int aunque filas * columnas no quepa
+    MPI_Datatype MPI_FILA_BLOQUE;
+    MPI_Type_contiguous(columnas, tipoMPI<T>(), &MPI_FILA_BLOQUE);
+    MPI_Type_commit(&MPI_FILA_BLOQUE);
+    MPI_File_read_at_all(fichero, 0, destino, filas, MPI_FILA_BLOQUE, MPI_STATUS_IGNORE);
+    MPI_Type_free(&MPI_FILA_BLOQUE);
+    MPI_File_close(&fichero);
+}
+
+struct ProyeccionMatriz {
+    void *base; // Comienzo de la proyeccion (la cabecera)
+    size_t longitud;
+};
+
+/*
+ Proyecta el fichero completo en memoria (solo lectura) y devuelve un puntero al
+ primer elemento de la matriz, o NULL si falla. Las paginas se comparten entre
+ todos los procesos del nodo a traves de la cache de ficheros del sistema.
+ */
+template <typename T>
+T *proyectaMatriz(const char *ruta, ProyeccionMatriz &proyeccion) {
+    proyeccion.base = NULL;
+    int descriptor = open(ruta, O_RDONLY);
+    if (descriptor < 0) {
+        return NULL;
+    }
+    struct stat datos;
+    if (fstat(descriptor, &datos) != 0 || datos.st_size < BYTES_CABECERA) {
+        close(descriptor);
+        return NULL;
+    }
+    proyeccion.longitud = datos.st_size;
+    void *base = mmap(NULL, proyeccion.longitud, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(base, proyeccion.longitud, MADV_SEQUENTIAL);
+    proyeccion.base = base;
+    return (T *) ((char *) base + BYTES_CABECERA);
+}
+
+inline void liberaProyeccion(ProyeccionMatriz &proyeccion) {
+    if (proyeccion.base != NULL) {
+        munmap(proyeccion.base, proyeccion.longitud);
+        proyeccion.base = NULL;
+    }
+}
+
+/*
+ Acceso fila a fila a la matriz completa en el proceso 0 cuando no la tiene en
+ memoria (para mostrarla y para la comprobacion secuencial): la toma de 'matriz'
+ si existe, y si no la lee del fichero o la genera con la semilla.
+ */
+template <typename T>
+class LectorFilas {
+public:
+    LectorFilas(const T *matriz, long n, unsigned long long semilla, const char *ruta)
+            : matriz(matriz), n(n), semilla(semilla), fichero(NULL), buffer(new T[n]) {
+        if (matriz == NULL && ruta != NULL) {
+            fichero = fopen(ruta, "rb");
+        }
+    }
+
+    ~LectorFilas() {
+        if (fichero != NULL) {
+            fclose(fichero);
+        }
+        delete [] buffer;
+    }
+
+    const T *fila(long i) {
+        if (matriz != NULL) {
+            return &matriz[i * n];
+        }
+        if (fichero != NULL) {
+            fseeko(fichero, BYTES_CABECERA + (off_t) i * n * sizeof(T), SEEK_SET);
+            if (fread(buffer, sizeof(T), n, fichero) != (size_t) n) {
+                // Solo lo usa el proceso 0, mientras el resto puede estar esperando en una colectiva
+                fprintf(stderr, "Error al leer la fila %ld del fichero de la matriz\n", i);
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+        } else {
+            generaBloque(semilla, n, i, 1, 0, n, buffer, n);
+        }
+        return buffer;
+    }
+
+private:
+    const T *matriz;
+    long n;
+    unsigned long long semilla;
+    FILE *fichero;
+    T *buffer;
+};
+
+#endif
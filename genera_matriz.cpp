@@ -0,0 +1,77 @@
+/*
+ ============================================================================
+ Name        : genera_matriz.cpp
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Escribe una matriz n x n en el formato binario de fichero_matriz.h.
+    Los valores salen del mismo generador que usan los programas, asi que con
+    la misma semilla el fichero contiene la misma matriz que --seed S genera.
+
+ Build: mpicxx genera_matriz.cpp -o genera_matriz
+ Run: ./genera_matriz <fichero> <n> [--dtype int32|int64|float|double] [--seed S]
+ ============================================================================
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+
+#include "fichero_matriz.h"
+
+using namespace std;
+
+template <typename T>
+bool escribeMatriz(FILE *fichero, long n, unsigned long long semilla) {
+    T *fila = new T[n];
+    bool correcto = true;
+    for (long i = 0; i < n && correcto; i++) {
+        generaBloque(semilla, n, i, 1, 0, n, fila, n);
+        correcto = fwrite(fila, sizeof(T), n, fichero) == (size_t) n;
+    }
+    delete [] fila;
+    return correcto;
+}
+
+int main(int argc, char * argv[]) {
+    TipoDato tipo = TIPO_INT64;
+    unsigned long long semilla = time(0);
+    bool argumentosValidos = (argc >= 3);
+    for (int i = 3; i < argc && argumentosValidos; i++) {
+        if (string(argv[i]) == "--dtype" && i + 1 < argc) {
+            argumentosValidos = tipoDatoDesdeNombre(argv[++i], tipo);
+        } else if (string(argv[i]) == "--seed" && i + 1 < argc) {
+            semilla = strtoull(argv[++i], NULL, 10);
+        } else {
+            argumentosValidos = false;
+        }
+    }
+    long n = argumentosValidos ? atol(argv[2]) : 0;
+    if (n <= 0) {
+        cout << "Uso: genera_matriz <fichero> <n> [--dtype int32|int64|float|double] [--seed S]" << endl;
+        return (1);
+    }
+
+    FILE *fichero = fopen(argv[1], "wb");
+    if (fichero == NULL) {
+        cout << "No se puede crear " << argv[1] << endl;
+        return (1);
+    }
+    CabeceraMatriz cabecera;
+    rellenaCabecera(cabecera, tipo, n, n);
+    bool correcto = fwrite(&cabecera, sizeof(cabecera), 1, fichero) == 1;
+    switch (tipo) {
+        case TIPO_INT32: correcto = correcto && escribeMatriz<int>(fichero, n, semilla); break;
+        case TIPO_INT64: correcto = correcto && escribeMatriz<long>(fichero, n, semilla); break;
+        case TIPO_FLOAT: correcto = correcto && escribeMatriz<float>(fichero, n, semilla); break;
+        case TIPO_DOUBLE: correcto = correcto && escribeMatriz<double>(fichero, n, semilla); break;
+        case TIPO_INT16: correcto = false; break; // Solo es tipo de almacenamiento (--storage), no de fichero
+    }
+    correcto = (fclose(fichero) == 0) && correcto;
+    if (!correcto) {
+        cout << "Error al escribir " << argv[1] << endl;
+        return (1);
+    }
+    cout << "Matriz " << n << " x " << n << " (" << nombreTipoDato(tipo) << ", semilla " << semilla << ") escrita en " << argv[1] << endl;
+}
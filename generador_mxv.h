@@ -0,0 +1,56 @@
+/*
+ ============================================================================
+ Name        : generador_mxv.h
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Generador determinista de la matriz y los vectores.
+    Cada elemento se obtiene mezclando la semilla con su posicion (generador
+    por contador, splitmix64), sin estado compartido. Asi cualquier proceso
+    puede generar solo sus filas o su submatriz y el resultado es el mismo que
+    si el proceso 0 generase la matriz entera, sea cual sea el numero de
+    procesos.
+ ============================================================================
+ */
+
+#ifndef GENERADOR_MXV_H
+#define GENERADOR_MXV_H
+
+// Finalizador de splitmix64: mezcla todos los bits de 'z'
+inline unsigned long long mezclaBits(unsigned long long z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Numero pseudoaleatorio numero 'indice' de la secuencia 'semilla'
+inline unsigned long long aleatorioEn(unsigned long long semilla, unsigned long long indice) {
+    return mezclaBits(semilla + (indice + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+// Elemento (i, j) de la matriz n x n, en [0, 1000)
+template <typename T>
+T valorMatriz(unsigned long long semilla, long n, long i, long j) {
+    return (T) (aleatorioEn(semilla, (unsigned long long) i * n + j) % 1000);
+}
+
+// Elemento i del vector v de x, en [0, 100). Cada vector tiene su propia secuencia, sin limite de k
+template <typename T>
+T valorVector(unsigned long long semilla, long i, int v) {
+    return (T) (aleatorioEn(mezclaBits(~semilla + (unsigned long long) v), i) % 100);
+}
+
+/*
+ Rellena el bloque de la matriz de filas [fila0, fila0 + filas) y columnas
+ [columna0, columna0 + columnas), guardado por filas con distancia 'ld'.
+ */
+template <typename T>
+void generaBloque(unsigned long long semilla, long n, long fila0, long filas, long columna0, long columnas, T *bloque, long ld) {
+    for (long i = 0; i < filas; i++) {
+        for (long j = 0; j < columnas; j++) {
+            bloque[i * ld + j] = valorMatriz<T>(semilla, n, fila0 + i, columna0 + j);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,520 @@
+/*
+ ============================================================================
+ Name        : kernel_mxv.h
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Nucleo de calculo local del producto Matriz por Vector.
+    Producto de un bloque de filas (o una submatriz) por un vector, comun a
+    matriz_x_vector.cpp y bidimensional_matriz_x_vector.cpp.
+
+ El nucleo es una plantilla sobre el tipo de elemento (int, long, float,
+ double). Recorre la matriz por teselas de columnas para que el trozo de x
+ que se usa quede en L1 aunque n sea grande, procesa cuatro filas a la vez
+ (cuatro acumuladores independientes que comparten cada carga de x) y tiene
+ versiones AVX2 y AVX-512 que se eligen en tiempo de ejecucion segun la CPU.
+ La variable de entorno MXV_ISA=generico|avx2|avx512 permite forzar una version
+ (por ejemplo para compararlas con bench_kernel_mxv.cpp), siempre que la CPU
+ la soporte; si no, se usa la mejor que soporte.
+
+ Compilado con -fopenmp, productoBloque reparte las filas entre los hilos del
+ proceso (modo hibrido: un proceso MPI por nodo NUMA o socket y un hilo por
+ nucleo). primerContacto() escribe cada bloque de filas desde el hilo que luego
+ lo va a multiplicar, para que sus paginas queden en la memoria de ese nodo NUMA.
+ Con un proceso por nodo NUMA (p. ej. OMP_NUM_THREADS=16 mpirun --map-by
+ ppr:1:numa --bind-to numa ...) hay 10-50 veces menos procesos en las
+ colectivas y una sola copia de x por nodo NUMA. Sin -fopenmp todo se ejecuta
+ en un solo hilo.
+
+ Todas las matrices se guardan por filas; 'ld' es la distancia (en elementos)
+ entre el comienzo de dos filas consecutivas, normalmente igual a 'columnas'.
+
+ Los elementos de A pueden guardarse en un tipo S mas estrecho que el de x e y
+ (T, el del acumulador; --storage en los programas): el nucleo los lee en S y
+ los convierte a T en los registros (__builtin_convertvector), asi que A ocupa
+ y mueve de memoria sizeof(S) bytes por elemento y las sumas se hacen en T.
+ Como cada elemento de A se usa una vez por vector, el producto esta limitado
+ por el ancho de banda de memoria y eso es lo que se gana. La matriz generada
+ tiene valores en [0, 1000), que caben exactos en int16. Con A en int16 y x en
+ int64 las multiplicaciones se hacen en int32 mientras x quepa en int16
+ (nucleoEstrecho); si no, sin multiplicacion vectorial de 64 bits en AVX2, el
+ tiempo es el de la matriz en int64.
+ ============================================================================
+ */
+
+#ifndef KERNEL_MXV_H
+#define KERNEL_MXV_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define MXV_SIEMPRE_INLINE inline __attribute__((always_inline))
+
+// Bytes de x que se reutilizan por tesela de columnas (la mitad de una L1 tipica)
+const long BYTES_TESELA_X = 16 * 1024;
+
+enum IsaNucleo { ISA_GENERICO, ISA_AVX2, ISA_AVX512 };
+
+inline const char *nombreIsa(IsaNucleo isa) {
+    switch (isa) {
+        case ISA_AVX2: return "avx2";
+        case ISA_AVX512: return "avx512";
+        default: return "generico";
+    }
+}
+
+/*
+ Juego de instrucciones que usa el nucleo: el que pida MXV_ISA si la CPU lo
+ soporta y, si no, el mejor que soporte.
+ */
+inline IsaNucleo detectaIsa() {
+    IsaNucleo mejor = ISA_GENERICO;
+#if defined(__GNUC__) && defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        mejor = ISA_AVX2;
+    }
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+        mejor = ISA_AVX512;
+    }
+#endif
+    const char *forzada = getenv("MXV_ISA");
+    if (forzada != NULL) {
+        for (int isa = ISA_GENERICO; isa <= mejor; isa++) {
+            if (std::string(forzada) == nombreIsa((IsaNucleo) isa)) {
+                return (IsaNucleo) isa;
+            }
+        }
+    }
+    return mejor;
+}
+
+inline IsaNucleo isaNucleo() {
+    static IsaNucleo isa = detectaIsa();
+    return isa;
+}
+
+// Numero de hilos con el que se ejecuta el nucleo en cada proceso
+inline int hilosNucleo() {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+// Fija el numero de hilos de cada proceso (sin efecto si no se compila con -fopenmp)
+inline void fijaHilos(int hilos) {
+#ifdef _OPENMP
+    omp_set_num_threads(hilos);
+#else
+    (void) hilos;
+#endif
+}
+
+/*
+ Filas [inicio, fin) de un bloque de 'filas' que calcula el hilo 'hilo' de
+ 'hilos'. El reparto es siempre el mismo para el mismo numero de filas, asi que
+ el hilo que toca primero unas filas (primerContacto) es el que luego las usa.
+ */
+inline void filasHilo(long filas, int hilo, int hilos, long &inicio, long &fin) {
+    inicio = filas * hilo / hilos;
+    fin = filas * (hilo + 1) / hilos;
+}
+
+/*
+ Escribe a cero el bloque de 'filas' x 'columnas' (distancia 'ld') repartiendo
+ las filas entre los hilos igual que productoBloque. Llamada justo despues de
+ reservar el bloque, hace que cada pagina se asigne en el nodo NUMA del hilo que
+ la va a leer (politica de primer contacto de Linux).
+ */
+template <typename T>
+void primerContacto(T *bloque, long ld, long filas, long columnas) {
+#ifdef _OPENMP
+#pragma omp parallel
+    {
+        long inicio, fin;
+        filasHilo(filas, omp_get_thread_num(), omp_get_num_threads(), inicio, fin);
+        for (long i = inicio; i < fin; i++) {
+            memset(&bloque[i * ld], 0, columnas * sizeof(T));
+        }
+    }
+#else
+    for (long i = 0; i < filas; i++) {
+        memset(&bloque[i * ld], 0, columnas * sizeof(T));
+    }
+#endif
+}
+
+/*
+ Bucle original de los programas: una fila cada vez, un solo acumulador.
+ Se mantiene como referencia para el micro-benchmark.
+ */
+template <typename S, typename T>
+void productoLocalSimple(const S *A, long ld, const T *x, T *y, long filas, long columnas) {
+    for (long i = 0; i < filas; i++) {
+        y[i] = 0;
+        for (long j = 0; j < columnas; j++) {
+            y[i] += (T) A[(i * ld) + j] * x[j];
+        }
+    }
+}
+
+/*
+ Tipo por el que se pasa al convertir un vector de A al tipo de x: GCC convierte
+ int16 a int64 o a double elemento a elemento, pero int16 a int32 y de ahi al
+ tipo final con instrucciones vectoriales.
+ */
+template <typename S> struct TipoIntermedio { typedef S tipo; };
+template <> struct TipoIntermedio<short> { typedef int tipo; };
+
+#define MXV_ENSANCHA(v) __builtin_convertvector(__builtin_convertvector(v, VectorI), Vector)
+
+/*
+ Nucleo teselado con vectores de BYTES bytes (extension vectorial de GCC/Clang).
+ Se compila dentro de las funciones con atributo 'target' de cada ISA, de modo
+ que el mismo codigo genera instrucciones SSE2, AVX2 o AVX-512. Los vectores
+ de A tienen los mismos W elementos que los de x, en el tipo S.
+ */
+template <typename S, typename T, int BYTES>
+MXV_SIEMPRE_INLINE void nucleoTeselado(const S *A, long ld, const T *x, T *y, long filas, long columnas) {
+    typedef T Vector __attribute__((vector_size(BYTES)));
+    const long W = BYTES / sizeof(T); // Elementos por vector
+    typedef S VectorA __attribute__((vector_size(BYTES / sizeof(T) * sizeof(S))));
+    typedef typename TipoIntermedio<S>::tipo I;
+    typedef I VectorI __attribute__((vector_size(BYTES / sizeof(T) * sizeof(I))));
+    const long BYTES_A = W * sizeof(S);
+    const long tesela = std::max(W, (BYTES_TESELA_X / (long) sizeof(T)) / W * W);
+
+    for (long i = 0; i < filas; i++) {
+        y[i] = 0;
+    }
+
+    for (long j0 = 0; j0 < columnas; j0 += tesela) {
+        long j1 = std::min(columnas, j0 + tesela);
+        long jv = j0 + ((j1 - j0) / W) * W; // Fin de la parte vectorial de la tesela
+
+        long i = 0;
+        // Cuatro filas a la vez: cada carga de x se usa cuatro veces
+        for (; i + 4 <= filas; i += 4) {
+            const S *a0 = &A[i * ld], *a1 = a0 + ld, *a2 = a1 + ld, *a3 = a2 + ld;
+            Vector s0 = {}, s1 = {}, s2 = {}, s3 = {};
+            for (long j = j0; j < jv; j += W) {
+                Vector vx;
+                VectorA v0, v1, v2, v3;
+                memcpy(&vx, &x[j], BYTES);
+                memcpy(&v0, &a0[j], BYTES_A);
+                memcpy(&v1, &a1[j], BYTES_A);
+                memcpy(&v2, &a2[j], BYTES_A);
+                memcpy(&v3, &a3[j], BYTES_A);
+                s0 += MXV_ENSANCHA(v0) * vx;
+                s1 += MXV_ENSANCHA(v1) * vx;
+                s2 += MXV_ENSANCHA(v2) * vx;
+                s3 += MXV_ENSANCHA(v3) * vx;
+            }
+            T r0 = 0, r1 = 0, r2 = 0, r3 = 0;
+            for (long l = 0; l < W; l++) {
+                r0 += s0[l];
+                r1 += s1[l];
+                r2 += s2[l];
+                r3 += s3[l];
+            }
+            for (long j = jv; j < j1; j++) {
+                r0 += (T) a0[j] * x[j];
+                r1 += (T) a1[j] * x[j];
+                r2 += (T) a2[j] * x[j];
+                r3 += (T) a3[j] * x[j];
+            }
+            y[i] += r0;
+            y[i + 1] += r1;
+            y[i + 2] += r2;
+            y[i + 3] += r3;
+        }
+        // Filas sueltas: dos acumuladores para no depender de la latencia de la suma
+        for (; i < filas; i++) {
+            const S *a = &A[i * ld];
+            Vector s0 = {}, s1 = {};
+            long j = j0;
+            for (; j + 2 * W <= jv; j += 2 * W) {
+                Vector vx0, vx1;
+                VectorA v0, v1;
+                memcpy(&vx0, &x[j], BYTES);
+                memcpy(&vx1, &x[j + W], BYTES);
+                memcpy(&v0, &a[j], BYTES_A);
+                memcpy(&v1, &a[j + W], BYTES_A);
+                s0 += MXV_ENSANCHA(v0) * vx0;
+                s1 += MXV_ENSANCHA(v1) * vx1;
+            }
+            s0 += s1;
+            T r = 0;
+            for (long l = 0; l < W; l++) {
+                r += s0[l];
+            }
+            for (; j < j1; j++) {
+                r += (T) a[j] * x[j];
+            }
+            y[i] += r;
+        }
+    }
+}
+
+#undef MXV_ENSANCHA
+
+/*
+ Nucleo para A en int16 con x e y en int64. AVX2 no tiene multiplicacion
+ vectorial de 64 bits (solo AVX-512DQ), asi que ensanchar A a int64 no gana
+ nada respecto a guardarla en int64. Si todos los x caben en int16, cada
+ producto de un elemento de A por uno de x cabe en int32: se multiplican en
+ vectores de int32 (el doble de elementos por vector) y cada acumulador de
+ int32 se vuelca a 64 bits antes de que pueda desbordar. Devuelve false, sin
+ tocar y, si algun x no cabe en int16.
+ */
+template <typename S, typename T, int BYTES>
+MXV_SIEMPRE_INLINE bool nucleoEstrecho(const S *A, long ld, const T *x, T *y, long filas, long columnas) {
+    typedef typename TipoIntermedio<S>::tipo I; // int
+    typedef I VectorI __attribute__((vector_size(BYTES)));
+    typedef S VectorA __attribute__((vector_size(BYTES / 2)));
+    const long W = BYTES / sizeof(I); // Elementos por vector
+    const long BYTES_A = W * sizeof(S);
+    const long tesela = std::max(W, (BYTES_TESELA_X / (long) sizeof(I)) / W * W);
+
+    long maximo = 0; // Mayor |x|
+    for (long j = 0; j < columnas; j++) {
+        if (x[j] < -32768 || x[j] > 32767) return false;
+        maximo = std::max(maximo, x[j] < 0 ? -x[j] : x[j]);
+    }
+    // Vectores que se suman en int32 antes de volcar: cada producto es como mucho 32768 * maximo
+    const long volcado = maximo == 0 ? columnas + 1 : std::max(1L, 2147483647L / (32768L * maximo));
+    I *x32 = new I [columnas];
+    for (long j = 0; j < columnas; j++) {
+        x32[j] = (I) x[j];
+    }
+
+    for (long i = 0; i < filas; i++) {
+        y[i] = 0;
+    }
+
+    for (long j0 = 0; j0 < columnas; j0 += tesela) {
+        long j1 = std::min(columnas, j0 + tesela);
+        long jv = j0 + ((j1 - j0) / W) * W; // Fin de la parte vectorial de la tesela
+
+        long i = 0;
+        // Cuatro filas a la vez, como nucleoTeselado
+        for (; i + 4 <= filas; i += 4) {
+            const S *a0 = &A[i * ld], *a1 = a0 + ld, *a2 = a1 + ld, *a3 = a2 + ld;
+            long r0 = 0, r1 = 0, r2 = 0, r3 = 0;
+            for (long jb = j0; jb < jv; jb += volcado * W) {
+                long je = std::min(jv, jb + volcado * W);
+                VectorI s0 = {}, s1 = {}, s2 = {}, s3 = {};
+                for (long j = jb; j < je; j += W) {
+                    VectorI vx;
+                    VectorA v0, v1, v2, v3;
+                    memcpy(&vx, &x32[j], BYTES);
+                    memcpy(&v0, &a0[j], BYTES_A);
+                    memcpy(&v1, &a1[j], BYTES_A);
+                    memcpy(&v2, &a2[j], BYTES_A);
+                    memcpy(&v3, &a3[j], BYTES_A);
+                    s0 += __builtin_convertvector(v0, VectorI) * vx;
+                    s1 += __builtin_convertvector(v1, VectorI) * vx;
+                    s2 += __builtin_convertvector(v2, VectorI) * vx;
+                    s3 += __builtin_convertvector(v3, VectorI) * vx;
+                }
+                for (long l = 0; l < W; l++) {
+                    r0 += s0[l];
+                    r1 += s1[l];
+                    r2 += s2[l];
+                    r3 += s3[l];
+                }
+            }
+            for (long j = jv; j < j1; j++) {
+                r0 += (long) a0[j] * x[j];
+                r1 += (long) a1[j] * x[j];
+                r2 += (long) a2[j] * x[j];
+                r3 += (long) a3[j] * x[j];
+            }
+            y[i] += r0;
+            y[i + 1] += r1;
+            y[i + 2] += r2;
+            y[i + 3] += r3;
+        }
+        for (; i < filas; i++) {
+            const S *a = &A[i * ld];
+            long r = 0;
+            for (long jb = j0; jb < jv; jb += volcado * W) {
+                long je = std::min(jv, jb + volcado * W);
+                VectorI s0 = {};
+                for (long j = jb; j < je; j += W) {
+                    VectorI vx;
+                    VectorA v0;
+                    memcpy(&vx, &x32[j], BYTES);
+                    memcpy(&v0, &a[j], BYTES_A);
+                    s0 += __builtin_convertvector(v0, VectorI) * vx;
+                }
+                for (long l = 0; l < W; l++) {
+                    r += s0[l];
+                }
+            }
+            for (long j = jv; j < j1; j++) {
+                r += (long) a[j] * x[j];
+            }
+            y[i] += r;
+        }
+    }
+    delete [] x32;
+    return true;
+}
+
+/*
+ Eleccion del nucleo para cada par de tipos: el teselado, salvo A en int16 con
+ x e y en int64, que prueba antes nucleoEstrecho.
+ */
+template <typename S, typename T, int BYTES>
+struct Nucleo {
+    static MXV_SIEMPRE_INLINE void producto(const S *A, long ld, const T *x, T *y, long filas, long columnas) {
+        nucleoTeselado<S, T, BYTES>(A, ld, x, y, filas, columnas);
+    }
+};
+
+template <int BYTES>
+struct Nucleo<short, long, BYTES> {
+    static MXV_SIEMPRE_INLINE void producto(const short *A, long ld, const long *x, long *y, long filas, long columnas) {
+        if (!nucleoEstrecho<short, long, BYTES>(A, ld, x, y, filas, columnas)) {
+            nucleoTeselado<short, long, BYTES>(A, ld, x, y, filas, columnas);
+        }
+    }
+};
+
+template <typename S, typename T>
+void productoLocalGenerico(const S *A, long ld, const T *x, T *y, long filas, long columnas) {
+    Nucleo<S, T, 16>::producto(A, ld, x, y, filas, columnas);
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+template <typename S, typename T>
+__attribute__((target("avx2,fma")))
+void productoLocalAvx2(const S *A, long ld, const T *x, T *y, long filas, long columnas) {
+    Nucleo<S, T, 32>::producto(A, ld, x, y, filas, columnas);
+}
+
+template <typename S, typename T>
+__attribute__((target("avx512f,avx512dq")))
+void productoLocalAvx512(const S *A, long ld, const T *x, T *y, long filas, long columnas) {
+    Nucleo<S, T, 64>::producto(A, ld, x, y, filas, columnas);
+}
+#endif
+
+/*
+ Producto local y = A * x con la version del nucleo que corresponda a la CPU.
+ */
+template <typename S, typename T>
+void productoLocal(const S *A, long ld, const T *x, T *y, long filas, long columnas, IsaNucleo isa = isaNucleo()) {
+#if defined(__GNUC__) && defined(__x86_64__)
+    if (isa == ISA_AVX512) {
+        productoLocalAvx512(A, ld, x, y, filas, columnas);
+        return;
+    }
+    if (isa == ISA_AVX2) {
+        productoLocalAvx2(A, ld, x, y, filas, columnas);
+        return;
+    }
+#endif
+    productoLocalGenerico(A, ld, x, y, filas, columnas);
+}
+
+/*
+ Producto local de un bloque de filas por k vectores a la vez: Y = A * X.
+ 'A' tiene 'filas' x 'columnas' elementos, X se guarda por filas ('columnas' x k,
+ el elemento j del vector v esta en X[j * k + v]) e Y igual ('filas' x k).
+ Cada elemento de A se lee una sola vez de memoria y se usa para los k vectores.
+ */
+template <typename S, typename T, int K>
+void productoBloqueFijo(const S *A, long ld, const T *X, T *Y, long filas, long columnas) {
+    // Version con k conocido en compilacion: los acumuladores de dos filas
+    // completas caben en registros
+    long i = 0;
+    for (; i + 1 < filas; i += 2) {
+        const S *fila0 = &A[i * ld];
+        const S *fila1 = fila0 + ld;
+        T acc0[K] = {0}, acc1[K] = {0};
+        for (long j = 0; j < columnas; j++) {
+            T a0 = fila0[j], a1 = fila1[j];
+            const T *xj = &X[j * K];
+            for (int v = 0; v < K; v++) {
+                acc0[v] += a0 * xj[v];
+                acc1[v] += a1 * xj[v];
+            }
+        }
+        for (int v = 0; v < K; v++) {
+            Y[i * K + v] = acc0[v];
+            Y[(i + 1) * K + v] = acc1[v];
+        }
+    }
+    for (; i < filas; i++) {
+        const S *fila = &A[i * ld];
+        T acc[K] = {0};
+        for (long j = 0; j < columnas; j++) {
+            T a = fila[j];
+            for (int v = 0; v < K; v++) {
+                acc[v] += a * X[j * K + v];
+            }
+        }
+        for (int v = 0; v < K; v++) {
+            Y[i * K + v] = acc[v];
+        }
+    }
+}
+
+template <typename S, typename T>
+void productoBloqueSecuencial(const S *A, long ld, const T *X, T *Y, long filas, long columnas, int k) {
+    switch (k) {
+        case 1: productoLocal(A, ld, X, Y, filas, columnas); return;
+        case 2: productoBloqueFijo<S, T, 2>(A, ld, X, Y, filas, columnas); return;
+        case 4: productoBloqueFijo<S, T, 4>(A, ld, X, Y, filas, columnas); return;
+        case 8: productoBloqueFijo<S, T, 8>(A, ld, X, Y, filas, columnas); return;
+    }
+    // Caso general: la fila de Y (k elementos) se mantiene en L1 mientras se
+    // recorre la fila de A
+    for (long i = 0; i < filas; i++) {
+        T *filaY = &Y[i * k];
+        for (int v = 0; v < k; v++) {
+            filaY[v] = 0;
+        }
+        for (long j = 0; j < columnas; j++) {
+            T a = A[i * ld + j];
+            const T *xj = &X[j * k];
+            for (int v = 0; v < k; v++) {
+                filaY[v] += a * xj[v];
+            }
+        }
+    }
+}
+
+/*
+ Producto local con todos los hilos del proceso: cada hilo calcula un trozo
+ consecutivo de filas (el mismo que le dio primerContacto) con el nucleo
+ secuencial. Con pocas filas, o si ya se esta dentro de una region paralela, se
+ calcula en un solo hilo.
+ */
+template <typename S, typename T>
+void productoBloque(const S *A, long ld, const T *X, T *Y, long filas, long columnas, int k) {
+#ifdef _OPENMP
+    if (filas >= 8 && omp_get_max_threads() > 1 && !omp_in_parallel()) {
+#pragma omp parallel
+        {
+            long inicio, fin;
+            filasHilo(filas, omp_get_thread_num(), omp_get_num_threads(), inicio, fin);
+            productoBloqueSecuencial(&A[inicio * ld], ld, X, &Y[inicio * k], fin - inicio, columnas, k);
+        }
+        return;
+    }
+#endif
+    productoBloqueSecuencial(A, ld, X, Y, filas, columnas, k);
+}
+
+#endif
@@ -5,18 +5,36 @@
  Version     :
  Copyright   : GNU Open Souce and Free license
  Description : Multiplicacion de Matrix por Vector.
-    Multiplica un vector por una matriz.
-
- Build: mpicxx matriz_x_vector.cpp -o mxv
- Run: mpirun --oversubscribe -np 4 mxv <n>
+    Multiplica un vector por una matriz. Este programa solo lee y valida las
+    opciones; el producto, las iteraciones, la comprobacion y el resumen los
+    hace libmxv (ejecutaPrograma de programa_mxv.h), donde esta explicada
+    cada opcion.
+
+ Build: make mxv (enlaza con libmxv, ver Makefile)
+ Run: mpirun --oversubscribe -np 4 mxv <n> [--iterations K] [--tolerance eps] [--rhs k]
+        [--dtype int32|int64|float|double] [--storage int16|int32|float] [--compress]
+        [--threads T] [--pipeline C] [--seed S] [--generate-local] [--weights w0,w1,... | --calibrate] [--warmup W] [--repeat R] [--csv f] [--json f]
+        [--verify full|freivalds|none] [--abft] [--profile] [--trace f] [--distributed-y] [--shared-x] [--persistent]
+        [--layout rows|columns|grid|auto] [--grid RxC] [--topology] [--tune-cache f]
+      mpirun --oversubscribe -np 4 mxv --file <fichero> [--mmap | --stream F] [opciones]
+      mpirun --oversubscribe -np 4 mxv <n> --sparse D [opciones]
  ============================================================================
  */
 
 #include <iostream>
 #include <cstdlib>
+#include <cstdio>
 #include <ctime>
 #include <mpi.h>
-#include <cmath>
+#include <string>
+
+#include "autoajuste_mxv.h"
+#include "distribuida_mxv.h"
+#include "fichero_matriz.h"
+#include "perfil_mxv.h"
+#include "programa_mxv.h"
+#include "utilidades_mxv.h"
+#include "verificacion_mxv.h"
 
 using namespace std;
 
@@ -24,191 +42,157 @@ int main(int argc, char * argv[]) {
 
     int numeroProcesadores,
             idProceso;
-    long    *A, // Matriz a multiplicar
-            *x, // Vector que vamos a multiplicar
-            *y, // Vector donde almacenamos el resultado
-            *misFilas, // Las filas que almacena localmente un proceso
-            *comprueba; // Guarda el resultado final (calculado secuencialmente), su valor
-                        // debe ser igual al de 'y'
-
-    long compruebaSum = 0; // Para mostrar resultado de comprobación para valores de n > 24
-    long ySum = 0; // Para mostrar resultado de comprobación para valores de n > 24
-
-    double tInicio, // Tiempo en el que comienza la ejecucion
-            tFin, // Tiempo en el que acaba la ejecucion
-            tSecuencialIni,
-            tSecuencialFin,
-            tSecuencial;
 
-    int n;
-    if (argc != 2) {
-        if (idProceso == 0) {
-            cout << "Uso: Pasar como parámetro dimensión de la matriz n" << endl;
-        }
-        return (0);
-    }
-    else {
-        n = atoi(argv[1]);
-    }
-
-    MPI_Init(&argc, &argv);
+    // Solo el hilo principal de cada proceso llama a MPI
+    int nivelHilos;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &nivelHilos);
     MPI_Comm_size(MPI_COMM_WORLD, &numeroProcesadores);
     MPI_Comm_rank(MPI_COMM_WORLD, &idProceso);
 
-    int nFilas = n / numeroProcesadores; // Numero de filas que procesa cada procesador
-    int nElem = nFilas * n; // Numero de elementos que procesa cada procesador
-    A = new long [nElem]; // Reservamos las filas de la matriz
-    x = new long [n]; // El vector sera del mismo tamaño que una fila de la matriz
-
-    // Variables para n % numeroProcesadores != 0
-    int filasUltimo = n - ((numeroProcesadores - 1) * nFilas);
-    int *elementosPorProcesador = new int[numeroProcesadores];
-    int *displenv = new int[numeroProcesadores];
-    int *displrecv = new int[numeroProcesadores];
-
-    // Solo el proceso 0 ejecuta el siguiente bloque
-    if (idProceso == 0) {
-        A = new long [n * n];
-        y = new long [n];
-
-        // Rellenamos 'A' y 'x' con valores aleatorios
-        cout << "Inicio carga de datos........" << endl;
-        srand(time(0));
-        for (unsigned int i = 0; i < n; i++) {
-            for (unsigned int j = 0; j < n; j++) {
-                A[i * n + j] = rand() % 1000;
-            }
-            x[i] = rand() % 100;
-        }
-        cout << "........Fin carga de datos" << endl;
-
-        if (n < 24) {
-            cout << "La matriz y el vector generados son " << endl;
-            for (unsigned int i = 0; i < n; i++) {
-                for (unsigned int j = 0; j < n; j++) {
-                    if (j == 0) cout << "[";
-                    cout << A[i * n + j];
-                    if (j == n - 1) cout << "]";
-                    else cout << "  ";
-                }
-                cout << "\t  [" << x[i] << "]" << endl;
-            }
-            cout << "\n";
-        }
-
-        // Calculamos valores para n % numeroProcesadores != 0 -------------------
-        cout << numeroProcesadores - 1 << " procesadores procesan " << nFilas << " filas y el ultimo procesa " << filasUltimo << " filas" << endl;
-
-        // Filas de cada procesador
-        for (int i = 0; i < numeroProcesadores -1; i++) {
-            elementosPorProcesador[i] = nFilas * n;
-        }
-        elementosPorProcesador[numeroProcesadores - 1] = filasUltimo * n;
-        cout << "Elementos que procesa cada procesador: [";
-        for (int i = 0; i < numeroProcesadores; i++) {
-            cout << " " << elementosPorProcesador[i];
-        }
-        cout << " ]" << endl;
-
-        // Desplazamiento en vectores
-        for (int i = 0; i < numeroProcesadores; i++) {
-            displenv[i] = i * nFilas * n;
-            displrecv[i] = i * nFilas;
-        }
-        cout << "Desplazamiento de envío para cada vector: [";
-        for (int i = 0; i < numeroProcesadores; i++) {
-            cout << " " << displenv[i];
-        }
-        cout << " ]" << endl;
-        cout << "Desplazamiento de recepción para cada vector: [";
-        for (int i = 0; i < numeroProcesadores; i++) {
-            cout << " " << displrecv[i];
-        }
-        cout << " ]" << endl;
-
-        // Reservamos espacio para la comprobacion
-        comprueba = new long [n];
-        // Realizamos el algoritmo secuencial para comprobar
-        cout << "Inicio algoritmo secuencial........" << endl;
-	    tSecuencialIni = clock();
-        // Lo calculamos de forma secuencial
-        for (unsigned int i = 0; i < n; i++) {
-            comprueba[i] = 0;
-            for (unsigned int j = 0; j < n; j++) {
-                comprueba[i] += A[i * n + j] * x[j];
-            }
+    ConfiguracionMxv configuracion; // Reparto y producto (distribuida_mxv.h y dispersa_mxv.h)
+    OpcionesPrograma opciones; // Tipos, iteraciones, repeticiones y comprobacion (programa_mxv.h)
+    configuracion.semilla = time(0);
+    bool generacionLocal = false, // Cada proceso genera sus filas, sin matriz completa en el proceso 0
+            proyeccion = false; // Usar las filas proyectadas en memoria (mmap) en lugar de leerlas
+    bool argumentosValidos = (argc >= 2), almacenIndicado = false;
+    for (int i = 1; i < argc && argumentosValidos; i++) {
+        if (i == 1 && argv[i][0] != '-') {
+            configuracion.n = atol(argv[i]);
+        } else if (string(argv[i]) == "--file" && i + 1 < argc) {
+            configuracion.fichero = argv[++i];
+        } else if (string(argv[i]) == "--mmap") {
+            proyeccion = true;
+        } else if (string(argv[i]) == "--stream" && i + 1 < argc) {
+            configuracion.filasPanel = atol(argv[++i]);
+            argumentosValidos = configuracion.filasPanel > 0;
+        } else if (string(argv[i]) == "--iterations" && i + 1 < argc) {
+            opciones.iteraciones = atoi(argv[++i]);
+        } else if (string(argv[i]) == "--tolerance" && i + 1 < argc) {
+            opciones.tolerancia = atof(argv[++i]);
+        } else if (string(argv[i]) == "--rhs" && i + 1 < argc) {
+            configuracion.k = atoi(argv[++i]);
+        } else if (string(argv[i]) == "--pipeline" && i + 1 < argc) {
+            configuracion.segmentos = atoi(argv[++i]);
+        } else if (string(argv[i]) == "--seed" && i + 1 < argc) {
+            configuracion.semilla = strtoull(argv[++i], NULL, 10);
+        } else if (string(argv[i]) == "--sparse" && i + 1 < argc) {
+            configuracion.noNulosFila = atol(argv[++i]);
+            argumentosValidos = configuracion.noNulosFila > 0;
+        } else if (string(argv[i]) == "--weights" && i + 1 < argc) {
+            // Lista de pesos separados por comas, uno por proceso
+            char *resto = argv[++i];
+            do {
+                double peso = strtod(resto, &resto);
+                argumentosValidos = argumentosValidos && peso > 0;
+                configuracion.pesos.push_back(peso);
+            } while (*resto++ == ',');
+            argumentosValidos = argumentosValidos && (int) configuracion.pesos.size() == numeroProcesadores;
+        } else if (string(argv[i]) == "--warmup" && i + 1 < argc) {
+            opciones.calentamiento = atoi(argv[++i]);
+        } else if (string(argv[i]) == "--repeat" && i + 1 < argc) {
+            opciones.repeticiones = atoi(argv[++i]);
+        } else if (string(argv[i]) == "--csv" && i + 1 < argc) {
+            opciones.csv = argv[++i];
+        } else if (string(argv[i]) == "--json" && i + 1 < argc) {
+            opciones.json = argv[++i];
+        } else if (string(argv[i]) == "--verify" && i + 1 < argc) {
+            argumentosValidos = verificacionDesdeNombre(argv[++i], opciones.verificacion);
+        } else if (string(argv[i]) == "--abft") {
+            configuracion.abft = true;
+        } else if (string(argv[i]) == "--distributed-y") {
+            configuracion.yRepartido = true;
+        } else if (string(argv[i]) == "--shared-x") {
+            configuracion.xCompartido = true;
+        } else if (string(argv[i]) == "--persistent") {
+            configuracion.persistentes = true;
+        } else if (string(argv[i]) == "--layout" && i + 1 < argc) {
+            opciones.autoajuste = string(argv[++i]) == "auto";
+            argumentosValidos = opciones.autoajuste || distribucionDesdeNombre(argv[i], configuracion.distribucion);
+        } else if (string(argv[i]) == "--grid" && i + 1 < argc) {
+            argumentosValidos = sscanf(argv[++i], "%dx%d", &configuracion.filasMalla, &configuracion.columnasMalla) == 2
+                    && configuracion.filasMalla > 0 && configuracion.columnasMalla > 0;
+        } else if (string(argv[i]) == "--topology") {
+            configuracion.topologia = true;
+        } else if (string(argv[i]) == "--tune-cache" && i + 1 < argc) {
+            opciones.cacheAjuste = argv[++i];
+        } else if (string(argv[i]) == "--profile") {
+            opciones.perfil = true;
+        } else if (string(argv[i]) == "--trace" && i + 1 < argc) {
+            opciones.traza = argv[++i];
+            opciones.perfil = true;
+        } else if (string(argv[i]) == "--calibrate") {
+            configuracion.calibrar = true;
+        } else if (string(argv[i]) == "--threads" && i + 1 < argc) {
+            opciones.hilos = atoi(argv[++i]);
+            argumentosValidos = opciones.hilos > 0;
+        } else if (string(argv[i]) == "--generate-local") {
+            generacionLocal = true;
+        } else if (string(argv[i]) == "--dtype" && i + 1 < argc) {
+            argumentosValidos = tipoDatoDesdeNombre(argv[++i], opciones.tipo);
+        } else if (string(argv[i]) == "--storage" && i + 1 < argc) {
+            argumentosValidos = almacenDesdeNombre(argv[++i], opciones.almacen);
+            almacenIndicado = true;
+        } else if (string(argv[i]) == "--compress") {
+            configuracion.comprimir = true;
+        } else {
+            argumentosValidos = false;
         }
-	    tSecuencialFin = clock();
-        cout << "........Fin algoritmo secuencial" << endl;
-        tSecuencial = (tSecuencialFin - tSecuencialIni) / CLOCKS_PER_SEC;
-        // Calculamos un solo valor para mostrar por pantalla si n grande
-        for (unsigned int i = 0; i < n; i++) {
-            compruebaSum += comprueba[i];
+    }
+    const bool dispersa = configuracion.noNulosFila > 0, conFichero = !configuracion.fichero.empty();
+    if (dispersa && conFichero) {
+        argumentosValidos = false; // La matriz dispersa solo se genera, no se lee de fichero
+    }
+    if (!almacenIndicado) {
+        opciones.almacen = opciones.tipo;
+    } else if (conFichero || dispersa || !almacenValido(opciones.almacen, opciones.tipo)) {
+        argumentosValidos = false; // El fichero fija el tipo de la matriz y la dispersa se guarda en CSR
+    }
+    if (configuracion.comprimir && (generacionLocal || conFichero || dispersa
+            || opciones.almacen == TIPO_FLOAT || opciones.almacen == TIPO_DOUBLE)) {
+        argumentosValidos = false; // Solo se comprime el reparto de A desde el proceso 0, y solo con enteros
+    }
+    if (configuracion.distribucion != DISTRIBUCION_FILAS || opciones.autoajuste) {
+        // Solo el reparto por filas tiene reparto segmentado, pesos y copia de x por nodo, y el modo disperso reparte por filas
+        argumentosValidos = argumentosValidos && configuracion.segmentos == 1 && configuracion.pesos.empty() && !configuracion.calibrar
+                && !configuracion.xCompartido && !dispersa;
+    }
+    if (configuracion.topologia && configuracion.distribucion != DISTRIBUCION_BLOQUES && !opciones.autoajuste) {
+        argumentosValidos = false; // Solo la malla por submatrices se coloca por nodos
+    }
+    if (configuracion.filasMalla > 0 && (configuracion.distribucion != DISTRIBUCION_BLOQUES || opciones.autoajuste
+            || configuracion.filasMalla * configuracion.columnasMalla != numeroProcesadores)) {
+        argumentosValidos = false; // --grid solo con --layout grid, y con R * C = numero de procesos
+    }
+    if (configuracion.filasPanel > 0 && (!conFichero || proyeccion)) {
+        argumentosValidos = false; // Los paneles se leen del fichero de --file
+    }
+    if (argumentosValidos && conFichero) {
+        // El tamaño y el tipo de dato los fija el fichero
+        CabeceraMatriz cabecera;
+        argumentosValidos = leeCabeceraMPI(configuracion.fichero.c_str(), cabecera, MPI_COMM_WORLD)
+                && cabecera.disposicion == DISPOSICION_FILAS && cabecera.filas == cabecera.columnas;
+        configuracion.n = cabecera.filas;
+        opciones.tipo = (TipoDato) cabecera.tipo;
+        opciones.almacen = opciones.tipo;
+        if (!argumentosValidos && idProceso == 0) {
+            cout << "El fichero " << configuracion.fichero << " no existe, no contiene una matriz cuadrada densa o no tiene el tamaño que indica su cabecera" << endl;
         }
-    } // Termina el trozo de codigo que ejecuta solo 0
-
-    // Ajustamos nº de filas del ultimo procesador
-    if (idProceso == (numeroProcesadores - 1)) {
-        nFilas = filasUltimo;
-        nElem = nFilas * n;
     }
-
-    // Reservamos espacio para la fila local de cada proceso
-    misFilas = new long [nElem];
-
-    MPI_Scatterv(A, // Matriz que vamos a compartir
-            elementosPorProcesador, // Numero de datos a compartir
-            displenv, // Desplazamiento dentro de los datos a compartir
-            MPI_LONG, // Tipo de dato a enviar
-            misFilas, // Vector en el que almacenar los datos
-            nElem, // Numero de datos a compartir
-            MPI_LONG, // Tipo de dato a recibir
-            0, // Proceso raiz que envia los datos
-            MPI_COMM_WORLD); // Comunicador utilizado (En este caso, el global)
-
-    // Compartimos el vector entre todas los procesos
-    MPI_Bcast(x, // Dato a compartir
-            n, // Numero de elementos que se van a enviar y recibir
-            MPI_LONG, // Tipo de dato que se compartira
-            0, // Proceso raiz que envia los datos
-            MPI_COMM_WORLD); // Comunicador utilizado (En este caso, el global)
-
-
-    // Hacemos una barrera para asegurar que todas los procesos comiencen la ejecucion
-    // a la vez, para tener mejor control del tiempo empleado
-    MPI_Barrier(MPI_COMM_WORLD);
-    // Inicio de medicion de tiempo
-    tInicio = MPI_Wtime();
-
-    long *subFinal = new long [nFilas];
-
-    for (unsigned int i = 0; i < nFilas; i++) {
-        subFinal[i] = 0;
-        for (unsigned int j = 0; j < n; j++) {
-            // cout << "proc=" << idProceso << ", i=" << i << ", j=" << j << ", subfinal[" << i << "] += " << misFilas[(i * n) + j] << " * " << x[j] << endl;
-            subFinal[i] += misFilas[(i * n) + j] * x[j];
+    if (!argumentosValidos || configuracion.n <= 0 || opciones.iteraciones < 1 || configuracion.k < 1 || configuracion.segmentos < 1
+            || opciones.calentamiento < 0 || opciones.repeticiones < 1 || (configuracion.xCompartido && configuracion.yRepartido)) {
+        if (idProceso == 0) {
+            cout << "Uso: Pasar como parámetro dimensión de la matriz n [--iterations K] [--tolerance eps] [--rhs k] [--dtype int32|int64|float|double] [--storage int16|int32|float] [--compress] [--pipeline C] [--seed S] [--generate-local] [--threads T] [--file fichero [--mmap | --stream F]] [--sparse D] [--weights w0,w1,... | --calibrate] [--warmup W] [--repeat R] [--csv fichero] [--json fichero] [--verify full|freivalds|none] [--abft] [--profile] [--trace fichero] [--distributed-y | --shared-x] [--persistent] [--layout rows|columns|grid|auto] [--grid RxC, con R * C = numero de procesos] [--topology] [--tune-cache fichero]" << endl;
         }
+        MPI_Finalize();
+        return (0);
+    }
+    if (conFichero) {
+        configuracion.carga = proyeccion ? CARGA_PROYECCION : configuracion.filasPanel > 0 ? CARGA_FLUJO : CARGA_FICHERO;
+    } else {
+        configuracion.carga = generacionLocal ? CARGA_GENERADA : CARGA_RAIZ;
     }
 
-    // Otra barrera para asegurar que todas ejecuten el siguiente trozo de c�digo lo
-    // mas proximamente posible
-    MPI_Barrier(MPI_COMM_WORLD);
-    // fin de medicion de tiempo
-    tFin = MPI_Wtime();
-
-    // Recogemos los datos de la multiplicacion, por cada proceso sera un escalar
-    // y se recoge en un vector, Gather se asegura de que la recolecci�n se haga
-    // en el mismo orden en el que se hace el Scatter, con lo que cada escalar
-    // acaba en su posicion correspondiente del vector.
-    MPI_Gatherv(subFinal, // Dato que envia cada proceso
-            nFilas, // Numero de elementos que se envian
-            MPI_LONG, // Tipo del dato que se envia
-            y, // Vector en el que se recolectan los datos
-            elementosPorProcesador, // Numero de datos que se esperan recibir por cada proceso
-            displrecv, // displs
-            MPI_LONG, // Tipo del dato que se recibira
-            0, // proceso que va a recibir los datos
-            MPI_COMM_WORLD); // Canal de comunicacion (Comunicador Global)
+    ejecutaPrograma(configuracion, opciones);
 
     // Terminamos la ejecucion de los procesos, despues de esto solo existira
     // el proceso 0
@@ -217,38 +201,4 @@ int main(int argc, char * argv[]) {
     // condicion si vamos a ejecutar mas codigo (Por ejemplo, con "if(rank==0)".
     MPI_Finalize();
 
-    if (idProceso == 0) {
-
-        unsigned int errores = 0;
-
-        cout << "El resultado obtenido y el esperado son:" << endl;
-        for (unsigned int i = 0; i < n; i++) {
-            ySum += y[i];
-            if (n < 24) {
-                cout << "\t" << y[i] << "\t|\t" << comprueba[i] << endl;
-            }
-            if (comprueba[i] != y[i])
-                errores++;
-        }
-        cout << "\tSUMA DE VECTORES: " << ySum << "\t|\t" << compruebaSum << endl;
-
-        delete [] y;
-        delete [] comprueba;
-
-        if (errores) {
-            cout << "Hubo " << errores << " errores." << endl;
-        } else {
-            cout << "No hubo errores" << endl;
-            cout << "El tiempo paralelo ha sido " << tFin - tInicio << " segundos." << endl;
-            cout << "El tiempo secuencial ha sido " << tSecuencial << " segundos." << endl;
-            cout << "La ganancia ha sido " << tSecuencial/(tFin - tInicio) << endl;
-        }
-
-    }
-
-    delete [] x;
-    delete [] A;
-    delete [] misFilas;
-
 }
-
@@ -0,0 +1,293 @@
+/*
+ ============================================================================
+ Name        : nodo_mxv.h
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Memoria compartida por los procesos de un mismo nodo (ventanas
+    de MPI-3) para la distribucion por filas de distribuida_mxv.h, y malla
+    colocada por nodos con colectivas en dos niveles para la distribucion por
+    submatrices.
+
+ Con MPI_Bcast cada proceso recibe su propia copia de x, aunque los procesos
+ de un nodo podrian leer la misma: en un nodo de 128 nucleos son 128 copias
+ compitiendo por el ancho de banda de memoria. Aqui los procesos se agrupan
+ por nodo (MPI_Comm_split_type con MPI_COMM_TYPE_SHARED), el de menor rango de
+ cada nodo es su lider y reserva una ventana compartida
+ (MPI_Win_allocate_shared) que el resto lee y escribe directamente. Las
+ comunicaciones entre nodos las hacen solo los lideres, con el comunicador
+ 'lideres'. Con xCompartido, x solo se difunde entre los lideres, cada
+ proceso escribe su trozo de y directamente en el y de su nodo y cada lider
+ envia al proceso 0 las filas de todo su nodo en un solo mensaje. No se
+ combina con yRepartido, ni lo usan el reparto segmentado ni el producto
+ disperso, que ya reparte x.
+
+ La ventana se abre con MPI_Win_lock_all y los accesos se ordenan con
+ sincronizaNodo (MPI_Win_sync y una barrera del nodo), el modelo de memoria
+ unificado de MPI-3 para memoria compartida.
+
+ En la malla de submatrices, creaMallaNodos ordena los procesos por nodo antes
+ de MPI_Cart_create, de modo que cada fila de la malla queda, en lo posible,
+ dentro de un nodo, y las colectivas de filas y columnas se hacen en dos
+ niveles (NivelesNodo): primero entre los procesos del nodo y despues solo
+ entre un proceso por nodo. Si C divide a los procesos por nodo, cada nodo
+ envia por la red una sola contribucion de y por fila de la malla y recibe una
+ sola copia de cada trozo de x. Las colectivas persistentes siguen siendo de
+ un nivel.
+ ============================================================================
+ */
+
+#ifndef NODO_MXV_H
+#define NODO_MXV_H
+
+#include <mpi.h>
+#include <vector>
+
+#include "colectivas_mxv.h"
+
+struct MemoriaNodo {
+    MPI_Comm nodo; // Procesos que comparten memoria con este
+    MPI_Comm lideres; // Un proceso por nodo, el de menor rango (MPI_COMM_NULL en el resto)
+    MPI_Win ventana; // Memoria compartida del nodo, reservada por su lider
+    void *base; // Comienzo de la memoria compartida en este proceso
+    int nodos; // Numero de nodos
+    std::vector<int> lider; // Rango (en el comunicador de partida) del lider de cada proceso
+};
+
+/*
+ Agrupa los procesos de 'comunicador' por nodo y reserva en cada nodo 'bytes'
+ de memoria compartida. Lo llaman todos los procesos; se libera con liberaNodo.
+ */
+inline void creaNodo(MPI_Comm comunicador, MPI_Aint bytes, MemoriaNodo &memoria) {
+    int id, idNodo;
+    MPI_Comm_rank(comunicador, &id);
+    MPI_Comm_split_type(comunicador, MPI_COMM_TYPE_SHARED, id, MPI_INFO_NULL, &memoria.nodo);
+    MPI_Comm_rank(memoria.nodo, &idNodo);
+    MPI_Comm_split(comunicador, idNodo == 0 ? 0 : MPI_UNDEFINED, id, &memoria.lideres);
+
+    int esLider = (idNodo == 0), lider = id;
+    MPI_Allreduce(&esLider, &memoria.nodos, 1, MPI_INT, MPI_SUM, comunicador);
+    MPI_Bcast(&lider, 1, MPI_INT, 0, memoria.nodo);
+    int P;
+    MPI_Comm_size(comunicador, &P);
+    memoria.lider.resize(P);
+    MPI_Allgather(&lider, 1, MPI_INT, &memoria.lider[0], 1, MPI_INT, comunicador);
+
+    // Solo el lider reserva; el resto obtiene la direccion de su memoria en este proceso
+    MPI_Win_allocate_shared(idNodo == 0 ? bytes : 0, 1, MPI_INFO_NULL, memoria.nodo, &memoria.base, &memoria.ventana);
+    if (idNodo != 0) {
+        MPI_Aint tamano;
+        int unidad;
+        MPI_Win_shared_query(memoria.ventana, 0, &tamano, &unidad, &memoria.base);
+    }
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, memoria.ventana);
+}
+
+// Hace visibles al resto del nodo las escrituras en la memoria compartida anteriores a la llamada
+inline void sincronizaNodo(const MemoriaNodo &memoria) {
+    MPI_Win_sync(memoria.ventana);
+    MPI_Barrier(memoria.nodo);
+    MPI_Win_sync(memoria.ventana);
+}
+
+inline void liberaNodo(MemoriaNodo &memoria) {
+    MPI_Win_unlock_all(memoria.ventana);
+    MPI_Win_free(&memoria.ventana);
+    if (memoria.lideres != MPI_COMM_NULL) {
+        MPI_Comm_free(&memoria.lideres);
+    }
+    MPI_Comm_free(&memoria.nodo);
+}
+
+/*
+ Tipo (ya confirmado) de las posiciones de todos los procesos cuyo lider es
+ 'lider', dentro de un vector repartido con 'cuentas' y 'despl' (en unidades de
+ 'tipoPosicion'). Los procesos de un nodo no tienen por que tener rangos, ni
+ filas, consecutivos. Hay que liberarlo con MPI_Type_free.
+ */
+inline MPI_Datatype tipoPosicionesNodo(const MemoriaNodo &memoria, int lider, const int *cuentas, const int *despl,
+        MPI_Datatype tipoPosicion) {
+    std::vector<int> longitudes, posiciones;
+    for (size_t r = 0; r < memoria.lider.size(); r++) {
+        if (memoria.lider[r] == lider && cuentas[r] > 0) {
+            longitudes.push_back(cuentas[r]);
+            posiciones.push_back(despl[r]);
+        }
+    }
+    MPI_Datatype tipo;
+    MPI_Type_indexed(longitudes.size(), longitudes.empty() ? NULL : &longitudes[0],
+            posiciones.empty() ? NULL : &posiciones[0], tipoPosicion, &tipo);
+    MPI_Type_commit(&tipo);
+    return tipo;
+}
+
+/*
+ Plan de recogeNodos, preparado una sola vez: los tipos de las posiciones de
+ cada nodo y las peticiones, para no crear tipos ni reservar memoria en cada
+ recogida. Se libera con liberaRecogidaNodos.
+ */
+struct RecogidaNodos {
+    int raiz;
+    MPI_Comm comunicador;
+    std::vector<int> origenes; // En la raiz, el lider de cada nodo remoto
+    std::vector<MPI_Datatype> tipos; // En la raiz, uno por nodo remoto; en el resto de lideres, el de su nodo
+    std::vector<MPI_Request> peticiones;
+};
+
+/*
+ Prepara la recogida en la raiz (que debe ser lider de su nodo, p. ej. el
+ proceso 0) de un vector repartido con 'cuentas' y 'despl' (en unidades de
+ 'tipoPosicion'). Lo llaman todos los procesos de 'comunicador'.
+ */
+inline void preparaRecogidaNodos(const MemoriaNodo &memoria, const int *cuentas, const int *despl, MPI_Datatype tipoPosicion,
+        int raiz, MPI_Comm comunicador, RecogidaNodos &recogida) {
+    recogida.raiz = raiz;
+    recogida.comunicador = comunicador;
+    if (memoria.lideres == MPI_COMM_NULL) return;
+    int id;
+    MPI_Comm_rank(comunicador, &id);
+    if (id != raiz) {
+        recogida.tipos.push_back(tipoPosicionesNodo(memoria, id, cuentas, despl, tipoPosicion));
+        return;
+    }
+    for (size_t r = 0; r < memoria.lider.size(); r++) {
+        if (memoria.lider[r] != (int) r || (int) r == raiz) continue;
+        recogida.origenes.push_back(r);
+        recogida.tipos.push_back(tipoPosicionesNodo(memoria, r, cuentas, despl, tipoPosicion));
+    }
+    recogida.peticiones.resize(recogida.origenes.size());
+}
+
+/*
+ Reune en la memoria de la raiz el vector 'v' cuyos trozos ya estan en la
+ memoria compartida de cada nodo, en su posicion: cada lider envia en un solo
+ mensaje las posiciones de su nodo. Solo intervienen los lideres, y el resto
+ del nodo debe haber escrito ya su trozo (sincronizaNodo).
+ */
+inline void recogeNodos(const MemoriaNodo &memoria, RecogidaNodos &recogida, void *v) {
+    if (memoria.lideres == MPI_COMM_NULL) return;
+    if (recogida.origenes.empty()) {
+        if (!recogida.tipos.empty()) {
+            MPI_Send(v, 1, recogida.tipos[0], recogida.raiz, ETIQUETA_NODO, recogida.comunicador);
+        }
+        return;
+    }
+    for (size_t i = 0; i < recogida.origenes.size(); i++) {
+        MPI_Irecv(v, 1, recogida.tipos[i], recogida.origenes[i], ETIQUETA_NODO, recogida.comunicador, &recogida.peticiones[i]);
+    }
+    MPI_Waitall(recogida.peticiones.size(), &recogida.peticiones[0], MPI_STATUSES_IGNORE);
+}
+
+inline void liberaRecogidaNodos(RecogidaNodos &recogida) {
+    for (size_t t = 0; t < recogida.tipos.size(); t++) {
+        MPI_Type_free(&recogida.tipos[t]);
+    }
+    recogida.tipos.clear();
+    recogida.origenes.clear();
+    recogida.peticiones.clear();
+}
+
+/*
+ Malla de 'filasMalla' x 'columnasMalla' procesos de 'comunicador' con
+ MPI_Cart_create (con reordenacion) sobre los procesos ordenados por nodo: los
+ de un mismo nodo tienen celdas seguidas, asi que llenan filas completas de la
+ malla. Devuelve en 'celda' la celda (fila * columnasMalla + columna) de cada
+ proceso y los comunicadores de cada fila y de cada columna (MPI_Cart_sub,
+ ordenados por columna y por fila). El proceso 0 queda siempre en la celda 0,
+ porque es la raiz de x e y: si la reordenacion lo mueve, se descarta.
+ */
+inline void creaMallaNodos(MPI_Comm comunicador, int filasMalla, int columnasMalla, std::vector<int> &celda,
+        MPI_Comm &filas, MPI_Comm &columnas) {
+    int id, P;
+    MPI_Comm_rank(comunicador, &id);
+    MPI_Comm_size(comunicador, &P);
+
+    // Los nodos en el orden de su lider (el de menor rango) y, dentro de cada nodo, por rango
+    MPI_Comm nodo, ordenado;
+    MPI_Comm_split_type(comunicador, MPI_COMM_TYPE_SHARED, id, MPI_INFO_NULL, &nodo);
+    int lider = id;
+    MPI_Bcast(&lider, 1, MPI_INT, 0, nodo);
+    MPI_Comm_split(comunicador, 0, lider, &ordenado); // A igual clave, el orden de los rangos
+
+    int dimensiones[2] = {filasMalla, columnasMalla}, periodicas[2] = {0, 0};
+    MPI_Comm malla;
+    celda.resize(P);
+    for (int reordenar = 1; reordenar >= 0; reordenar--) {
+        MPI_Cart_create(ordenado, 2, dimensiones, periodicas, reordenar, &malla);
+        int miCelda;
+        MPI_Comm_rank(malla, &miCelda);
+        MPI_Allgather(&miCelda, 1, MPI_INT, &celda[0], 1, MPI_INT, comunicador);
+        if (celda[0] == 0) break;
+        MPI_Comm_free(&malla);
+    }
+
+    int restoFila[2] = {0, 1}, restoColumna[2] = {1, 0}; // Dimension que se conserva en cada subcomunicador
+    MPI_Cart_sub(malla, restoFila, &filas);
+    MPI_Cart_sub(malla, restoColumna, &columnas);
+    MPI_Comm_free(&malla);
+    MPI_Comm_free(&ordenado);
+    MPI_Comm_free(&nodo);
+}
+
+/*
+ Dos niveles de un comunicador: los procesos de cada nodo y un proceso por nodo
+ (el de menor rango, asi que el proceso 0 esta en los dos).
+ */
+struct NivelesNodo {
+    MPI_Comm nodo;
+    MPI_Comm lideres; // MPI_COMM_NULL fuera de los lideres
+    int nodos;
+    int procesosNodo;
+};
+
+inline void creaNiveles(MPI_Comm comunicador, NivelesNodo &niveles) {
+    int id, idNodo;
+    MPI_Comm_rank(comunicador, &id);
+    MPI_Comm_split_type(comunicador, MPI_COMM_TYPE_SHARED, id, MPI_INFO_NULL, &niveles.nodo);
+    MPI_Comm_rank(niveles.nodo, &idNodo);
+    MPI_Comm_size(niveles.nodo, &niveles.procesosNodo);
+    MPI_Comm_split(comunicador, idNodo == 0 ? 0 : MPI_UNDEFINED, id, &niveles.lideres);
+    int esLider = (idNodo == 0);
+    MPI_Allreduce(&esLider, &niveles.nodos, 1, MPI_INT, MPI_SUM, comunicador);
+}
+
+inline void liberaNiveles(NivelesNodo &niveles) {
+    if (niveles.lideres != MPI_COMM_NULL) {
+        MPI_Comm_free(&niveles.lideres);
+    }
+    if (niveles.nodo != MPI_COMM_NULL) {
+        MPI_Comm_free(&niveles.nodo);
+    }
+}
+
+// MPI_Bcast desde el proceso 0: primero entre los lideres de los nodos y despues dentro de cada nodo
+inline void difundeNiveles(void *datos, int cuenta, MPI_Datatype tipo, const NivelesNodo &niveles) {
+    if (niveles.lideres != MPI_COMM_NULL && niveles.nodos > 1) {
+        MPI_Bcast(datos, cuenta, tipo, 0, niveles.lideres);
+    }
+    if (niveles.procesosNodo > 1) {
+        MPI_Bcast(datos, cuenta, tipo, 0, niveles.nodo);
+    }
+}
+
+/*
+ Reduccion en el proceso 0: primero dentro de cada nodo, en 'parcial' de su
+ lider, y despues entre los lideres. Con un solo nivel util (un nodo, o un
+ proceso en el nodo) se reduce directamente, sin pasar por 'parcial'.
+ */
+inline void reduceNiveles(const void *envio, void *recepcion, void *parcial, long cuenta, MPI_Datatype tipo,
+        MPI_Op operacion, const NivelesNodo &niveles) {
+    if (niveles.nodos == 1) {
+        reduceGrande(envio, recepcion, cuenta, tipo, operacion, 0, niveles.nodo);
+        return;
+    }
+    if (niveles.procesosNodo > 1) {
+        reduceGrande(envio, parcial, cuenta, tipo, operacion, 0, niveles.nodo);
+        envio = parcial;
+    }
+    if (niveles.lideres != MPI_COMM_NULL) {
+        reduceGrande(envio, recepcion, cuenta, tipo, operacion, 0, niveles.lideres);
+    }
+}
+
+#endif
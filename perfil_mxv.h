@@ -0,0 +1,383 @@
+/*
+ ============================================================================
+ Name        : perfil_mxv.h
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Perfil por proceso de las operaciones colectivas y del calculo
+    local (--profile y --trace) para matriz_x_vector.cpp y
+    bidimensional_matriz_x_vector.cpp.
+
+ Las operaciones MPI se interceptan con la interfaz de perfilado de MPI (PMPI):
+ este fichero define MPI_Bcast, MPI_Scatterv, MPI_Reduce... que miden el
+ tiempo y los bytes que mueve el proceso y llaman a la version PMPI_ real. Por
+ eso las envolturas solo se definen en un fichero .cpp de cada programa: el
+ resto (los .cpp de la biblioteca libmxv) lo incluye con
+ PERFIL_MXV_SIN_ENVOLTURAS definido y sus llamadas a MPI pasan igualmente por
+ las del programa al enlazarlo. El calculo local se anota con anotaCalculo(),
+ midiendo solo el nucleo y no las barreras que lo rodean, y el tiempo en
+ MPI_Barrier aparece aparte: es la espera por el proceso mas lento. Las
+ llamadas de MPI-IO (apertura, lectura colectiva y lectura de paneles) se
+ anotan igual; la espera por un panel aparece en MPI_Wait.
+
+ Al terminar, resumePerfil() muestra para cada operacion el minimo, la media y
+ el maximo entre procesos del tiempo, el desequilibrio (maximo / media), los
+ bytes y los GB/s, y el proceso mas lento. Con --trace fichero escribe ademas
+ una linea temporal de todas las llamadas de todos los procesos en el formato
+ de eventos de Chrome (se abre con chrome://tracing o ui.perfetto.dev).
+ ============================================================================
+ */
+
+#ifndef PERFIL_MXV_H
+#define PERFIL_MXV_H
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+enum OperacionPerfil {
+    OP_CALCULO, OP_SCATTER, OP_BCAST, OP_REDUCE, OP_ALLREDUCE, OP_REDUCE_SCATTER, OP_GATHER, OP_ALLGATHER,
+    OP_VECINOS, OP_LECTURA, OP_LECTURA_PANEL, OP_FICHERO, OP_ESPERA, OP_BARRERA, NUMERO_OPERACIONES
+};
+
+inline const char *nombreOperacion(int operacion) {
+    switch (operacion) {
+        case OP_CALCULO: return "calculo";
+        case OP_SCATTER: return "MPI_Scatter(v)";
+        case OP_BCAST: return "MPI_Bcast";
+        case OP_REDUCE: return "MPI_Reduce";
+        case OP_ALLREDUCE: return "MPI_Allreduce";
+        case OP_REDUCE_SCATTER: return "MPI_Reduce_scatter";
+        case OP_GATHER: return "MPI_Gather(v)";
+        case OP_ALLGATHER: return "MPI_Allgatherv";
+        case OP_VECINOS: return "MPI_Neighbor_alltoallv";
+        case OP_LECTURA: return "MPI_File_read_at_all";
+        case OP_LECTURA_PANEL: return "MPI_File_iread_at";
+        case OP_FICHERO: return "MPI_File_open/close";
+        case OP_ESPERA: return "MPI_Wait(all)";
+        default: return "MPI_Barrier";
+    }
+}
+
+struct EventoTraza {
+    int operacion;
+    double inicio, fin; // Segundos desde iniciaPerfil()
+    double bytes;
+};
+
+struct EstadoPerfil {
+    bool activo;
+    bool traza;
+    double origen; // Instante de iniciaPerfil()
+    double llamadas[NUMERO_OPERACIONES];
+    double tiempo[NUMERO_OPERACIONES];
+    double bytes[NUMERO_OPERACIONES];
+    std::vector<EventoTraza> eventos;
+};
+
+inline EstadoPerfil &estadoPerfil() {
+    static EstadoPerfil estado = EstadoPerfil();
+    return estado;
+}
+
+// Todos los procesos a la vez: las marcas de tiempo de la traza cuentan desde aqui
+inline void iniciaPerfil(bool traza) {
+    EstadoPerfil &estado = estadoPerfil();
+    PMPI_Barrier(MPI_COMM_WORLD);
+    estado.activo = true;
+    estado.traza = traza;
+    estado.origen = PMPI_Wtime();
+}
+
+inline void anotaOperacion(OperacionPerfil operacion, double inicio, double fin, double bytes) {
+    EstadoPerfil &estado = estadoPerfil();
+    if (!estado.activo) return;
+    estado.llamadas[operacion]++;
+    estado.tiempo[operacion] += fin - inicio;
+    estado.bytes[operacion] += bytes;
+    if (estado.traza) {
+        EventoTraza evento = {operacion, inicio - estado.origen, fin - estado.origen, bytes};
+        estado.eventos.push_back(evento);
+    }
+}
+
+// Calculo local entre 'inicio' y 'fin' (MPI_Wtime), leyendo 'bytes' de la matriz
+inline void anotaCalculo(double inicio, double fin, double bytes) {
+    anotaOperacion(OP_CALCULO, inicio, fin, bytes);
+}
+
+inline double bytesTipo(MPI_Datatype tipo, long cuenta) {
+    MPI_Count tamano; // Los tipos de filas o submatrices pueden ocupar mas de 2^31 bytes
+    MPI_Type_size_x(tipo, &tamano);
+    return (double) tamano * cuenta;
+}
+
+inline long sumaCuentas(const int *cuentas, int numero) {
+    long total = 0;
+    for (int i = 0; i < numero; i++) {
+        total += cuentas[i];
+    }
+    return total;
+}
+
+inline int rangoEn(MPI_Comm comunicador) {
+    int id;
+    MPI_Comm_rank(comunicador, &id);
+    return id;
+}
+
+inline int tamanoDe(MPI_Comm comunicador) {
+    int tamano;
+    MPI_Comm_size(comunicador, &tamano);
+    return tamano;
+}
+
+#ifndef PERFIL_MXV_SIN_ENVOLTURAS
+
+/*
+ Envolturas PMPI. Los bytes son los que envia o recibe este proceso: en las
+ operaciones con raiz, la raiz cuenta todo lo que reparte o recoge.
+ */
+extern "C" {
+
+int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_Bcast(buffer, count, datatype, root, comm);
+    anotaOperacion(OP_BCAST, inicio, PMPI_Wtime(), bytesTipo(datatype, count));
+    return resultado;
+}
+
+int MPI_Scatter(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+        MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_Scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    double bytes = rangoEn(comm) == root ? bytesTipo(sendtype, (long) sendcount * tamanoDe(comm)) : bytesTipo(recvtype, recvcount);
+    anotaOperacion(OP_SCATTER, inicio, PMPI_Wtime(), bytes);
+    return resultado;
+}
+
+int MPI_Scatterv(const void *sendbuf, const int sendcounts[], const int displs[], MPI_Datatype sendtype,
+        void *recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_Scatterv(sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    double bytes = rangoEn(comm) == root ? bytesTipo(sendtype, sumaCuentas(sendcounts, tamanoDe(comm))) : bytesTipo(recvtype, recvcount);
+    anotaOperacion(OP_SCATTER, inicio, PMPI_Wtime(), bytes);
+    return resultado;
+}
+
+// En las operaciones no bloqueantes se anota el inicio; la espera va aparte en MPI_Wait(all)
+int MPI_Iscatterv(const void *sendbuf, const int sendcounts[], const int displs[], MPI_Datatype sendtype,
+        void *recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm, MPI_Request *request) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_Iscatterv(sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount, recvtype, root, comm, request);
+    double bytes = rangoEn(comm) == root ? bytesTipo(sendtype, sumaCuentas(sendcounts, tamanoDe(comm))) : bytesTipo(recvtype, recvcount);
+    anotaOperacion(OP_SCATTER, inicio, PMPI_Wtime(), bytes);
+    return resultado;
+}
+
+int MPI_Gather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+        MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+    double bytes = rangoEn(comm) == root ? bytesTipo(recvtype, (long) recvcount * tamanoDe(comm)) : bytesTipo(sendtype, sendcount);
+    anotaOperacion(OP_GATHER, inicio, PMPI_Wtime(), bytes);
+    return resultado;
+}
+
+int MPI_Gatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
+        const int displs[], MPI_Datatype recvtype, int root, MPI_Comm comm) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm);
+    double bytes = rangoEn(comm) == root ? bytesTipo(recvtype, sumaCuentas(recvcounts, tamanoDe(comm))) : bytesTipo(sendtype, sendcount);
+    anotaOperacion(OP_GATHER, inicio, PMPI_Wtime(), bytes);
+    return resultado;
+}
+
+int MPI_Igatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
+        const int displs[], MPI_Datatype recvtype, int root, MPI_Comm comm, MPI_Request *request) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_Igatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm, request);
+    double bytes = rangoEn(comm) == root ? bytesTipo(recvtype, sumaCuentas(recvcounts, tamanoDe(comm))) : bytesTipo(sendtype, sendcount);
+    anotaOperacion(OP_GATHER, inicio, PMPI_Wtime(), bytes);
+    return resultado;
+}
+
+int MPI_Wait(MPI_Request *request, MPI_Status *status) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_Wait(request, status);
+    anotaOperacion(OP_ESPERA, inicio, PMPI_Wtime(), 0);
+    return resultado;
+}
+
+int MPI_Waitall(int count, MPI_Request array_of_requests[], MPI_Status array_of_statuses[]) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_Waitall(count, array_of_requests, array_of_statuses);
+    anotaOperacion(OP_ESPERA, inicio, PMPI_Wtime(), 0);
+    return resultado;
+}
+
+int MPI_Reduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_Reduce(sendbuf, recvbuf, count, datatype, op, root, comm);
+    anotaOperacion(OP_REDUCE, inicio, PMPI_Wtime(), bytesTipo(datatype, count));
+    return resultado;
+}
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm);
+    anotaOperacion(OP_ALLREDUCE, inicio, PMPI_Wtime(), bytesTipo(datatype, count));
+    return resultado;
+}
+
+int MPI_Reduce_scatter(const void *sendbuf, void *recvbuf, const int recvcounts[], MPI_Datatype datatype, MPI_Op op,
+        MPI_Comm comm) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_Reduce_scatter(sendbuf, recvbuf, recvcounts, datatype, op, comm);
+    anotaOperacion(OP_REDUCE_SCATTER, inicio, PMPI_Wtime(), bytesTipo(datatype, sumaCuentas(recvcounts, tamanoDe(comm))));
+    return resultado;
+}
+
+int MPI_Allgatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, const int recvcounts[],
+        const int displs[], MPI_Datatype recvtype, MPI_Comm comm) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, comm);
+    anotaOperacion(OP_ALLGATHER, inicio, PMPI_Wtime(), bytesTipo(recvtype, sumaCuentas(recvcounts, tamanoDe(comm))));
+    return resultado;
+}
+
+int MPI_Neighbor_alltoallv(const void *sendbuf, const int sendcounts[], const int sdispls[], MPI_Datatype sendtype,
+        void *recvbuf, const int recvcounts[], const int rdispls[], MPI_Datatype recvtype, MPI_Comm comm) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_Neighbor_alltoallv(sendbuf, sendcounts, sdispls, sendtype, recvbuf, recvcounts, rdispls, recvtype, comm);
+    int origenes, destinos, ponderado;
+    MPI_Dist_graph_neighbors_count(comm, &origenes, &destinos, &ponderado);
+    double bytes = bytesTipo(sendtype, sumaCuentas(sendcounts, destinos)) + bytesTipo(recvtype, sumaCuentas(recvcounts, origenes));
+    anotaOperacion(OP_VECINOS, inicio, PMPI_Wtime(), bytes);
+    return resultado;
+}
+
+int MPI_File_read_at_all(MPI_File fh, MPI_Offset offset, void *buf, int count, MPI_Datatype datatype, MPI_Status *status) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_File_read_at_all(fh, offset, buf, count, datatype, status);
+    anotaOperacion(OP_LECTURA, inicio, PMPI_Wtime(), bytesTipo(datatype, count));
+    return resultado;
+}
+
+// Lectura de un panel (--stream): aqui solo se anota el inicio; la espera por los datos va en MPI_Wait
+int MPI_File_iread_at(MPI_File fh, MPI_Offset offset, void *buf, int count, MPI_Datatype datatype, MPI_Request *request) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_File_iread_at(fh, offset, buf, count, datatype, request);
+    anotaOperacion(OP_LECTURA_PANEL, inicio, PMPI_Wtime(), bytesTipo(datatype, count));
+    return resultado;
+}
+
+int MPI_File_open(MPI_Comm comm, const char *filename, int amode, MPI_Info info, MPI_File *fh) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_File_open(comm, filename, amode, info, fh);
+    anotaOperacion(OP_FICHERO, inicio, PMPI_Wtime(), 0);
+    return resultado;
+}
+
+int MPI_File_close(MPI_File *fh) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_File_close(fh);
+    anotaOperacion(OP_FICHERO, inicio, PMPI_Wtime(), 0);
+    return resultado;
+}
+
+int MPI_Barrier(MPI_Comm comm) {
+    double inicio = PMPI_Wtime();
+    int resultado = PMPI_Barrier(comm);
+    anotaOperacion(OP_BARRERA, inicio, PMPI_Wtime(), 0);
+    return resultado;
+}
+
+}
+
+#endif
+
+/*
+ Resumen del perfil de todos los procesos en el proceso 0 y, si se pidio, la
+ traza en 'ficheroTraza'. Lo llaman todos los procesos; sus propias
+ comunicaciones van directamente a PMPI y no se anotan.
+ */
+inline void resumePerfil(const std::string &ficheroTraza, MPI_Comm comunicador) {
+    EstadoPerfil &estado = estadoPerfil();
+    if (!estado.activo) return;
+    estado.activo = false;
+    int id = rangoEn(comunicador), P = tamanoDe(comunicador);
+
+    const int campos = 3 * NUMERO_OPERACIONES;
+    double propios[campos];
+    for (int o = 0; o < NUMERO_OPERACIONES; o++) {
+        propios[3 * o] = estado.llamadas[o];
+        propios[3 * o + 1] = estado.tiempo[o];
+        propios[3 * o + 2] = estado.bytes[o];
+    }
+    std::vector<double> todos(id == 0 ? campos * P : 1);
+    PMPI_Gather(propios, campos, MPI_DOUBLE, &todos[0], campos, MPI_DOUBLE, 0, comunicador);
+
+    if (id == 0) {
+        std::cout << "Perfil por proceso (tiempo en segundos: minimo / media / maximo entre procesos):" << std::endl;
+        std::cout << "Operacion\t\tllamadas\tminimo\tmedia\tmaximo\tdesequilibrio\tlento\tMB medios\tGB/s medios" << std::endl;
+        for (int o = 0; o < NUMERO_OPERACIONES; o++) {
+            double minimo = 0, maximo = 0, suma = 0, sumaBytes = 0, llamadas = 0;
+            int lento = 0;
+            for (int r = 0; r < P; r++) {
+                double t = todos[r * campos + 3 * o + 1];
+                if (r == 0 || t < minimo) minimo = t;
+                if (r == 0 || t > maximo) {
+                    maximo = t;
+                    lento = r;
+                }
+                suma += t;
+                sumaBytes += todos[r * campos + 3 * o + 2];
+                llamadas = std::max(llamadas, todos[r * campos + 3 * o]);
+            }
+            if (llamadas == 0) continue;
+            double media = suma / P;
+            std::cout << nombreOperacion(o) << "\t\t" << llamadas << "\t" << minimo << "\t" << media << "\t" << maximo
+                    << "\t" << (media > 0 ? maximo / media : 1) << "\t" << lento
+                    << "\t" << sumaBytes / P / 1e6 << "\t" << (suma > 0 ? sumaBytes / suma / 1e9 : 0) << std::endl;
+        }
+    }
+
+    if (ficheroTraza.empty()) return;
+    // Todos los eventos al proceso 0, que escribe la linea temporal (un hilo por proceso)
+    int numeroEventos = estado.eventos.size();
+    std::vector<int> eventosPorProceso(P), desplazamientos(P);
+    PMPI_Gather(&numeroEventos, 1, MPI_INT, &eventosPorProceso[0], 1, MPI_INT, 0, comunicador);
+    long total = 0;
+    for (int r = 0; r < P; r++) {
+        desplazamientos[r] = total * sizeof(EventoTraza);
+        total += eventosPorProceso[r];
+        eventosPorProceso[r] *= sizeof(EventoTraza);
+    }
+    std::vector<EventoTraza> eventos(id == 0 ? total + 1 : 1);
+    PMPI_Gatherv(estado.eventos.empty() ? NULL : &estado.eventos[0], numeroEventos * sizeof(EventoTraza), MPI_BYTE,
+            &eventos[0], &eventosPorProceso[0], &desplazamientos[0], MPI_BYTE, 0, comunicador);
+    if (id != 0) return;
+    FILE *fichero = fopen(ficheroTraza.c_str(), "w");
+    if (fichero == NULL) {
+        std::cout << "No se puede crear " << ficheroTraza << std::endl;
+        return;
+    }
+    fprintf(fichero, "{\"traceEvents\": [\n");
+    long e = 0;
+    for (int r = 0; r < P; r++) {
+        for (int i = 0; i < eventosPorProceso[r] / (int) sizeof(EventoTraza); i++, e++) {
+            fprintf(fichero, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"bytes\": %.0f}}\n",
+                    e ? "," : "", nombreOperacion(eventos[e].operacion), r, eventos[e].inicio * 1e6,
+                    (eventos[e].fin - eventos[e].inicio) * 1e6, eventos[e].bytes);
+        }
+    }
+    fprintf(fichero, "]}\n");
+    fclose(fichero);
+    std::cout << "Traza de " << total << " eventos escrita en " << ficheroTraza << std::endl;
+}
+
+#endif
@@ -0,0 +1,544 @@
+/*
+ ============================================================================
+ Name        : programa_mxv.cpp
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Implementacion de ejecutaPrograma (programa_mxv.h) en libmxv:
+    datos, repeticiones, comprobacion y resumen de los productos denso y
+    disperso.
+
+ Build: make libmxv.a libmxv.so
+ ============================================================================
+ */
+
+#include <iostream>
+#include <mpi.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Las envolturas PMPI las define cada programa (perfil_mxv.h)
+#define PERFIL_MXV_SIN_ENVOLTURAS
+
+#include "autoajuste_mxv.h"
+#include "csr_mxv.h"
+#include "dispersa_mxv.h"
+#include "distribuida_mxv.h"
+#include "fases_mxv.h"
+#include "fichero_matriz.h"
+#include "generador_mxv.h"
+#include "kernel_mxv.h"
+#include "perfil_mxv.h"
+#include "programa_mxv.h"
+#include "utilidades_mxv.h"
+#include "verificacion_mxv.h"
+
+using namespace std;
+
+// Posiciones [primera, primera + posiciones) de los k vectores x iniciales
+template <typename T>
+static void generaVector(unsigned long long semilla, long primera, long posiciones, int k, T *x) {
+    for (long i = 0; i < posiciones; i++) {
+        for (int v = 0; v < k; v++) {
+            x[i * k + v] = valorVector<T>(semilla, primera + i, v);
+        }
+    }
+}
+
+// y = A x secuencial con la matriz densa, fila a fila
+template <typename T, typename S>
+static void productoSecuencial(LectorFilas<S> &A, long n, int k, const T *x, T *y) {
+    for (long i = 0; i < n; i++) {
+        const S *fila = A.fila(i);
+        for (int v = 0; v < k; v++) {
+            y[i * k + v] = 0;
+            for (long j = 0; j < n; j++) {
+                y[i * k + v] += (T) fila[j] * x[j * k + v];
+            }
+        }
+    }
+}
+
+// y = A x secuencial con la matriz dispersa completa (columnas globales)
+template <typename T>
+static void productoSecuencial(const MatrizCSR<T> &A, long n, int k, const T *x, T *y) {
+    for (long i = 0; i < n; i++) {
+        for (int v = 0; v < k; v++) {
+            y[i * k + v] = 0;
+            for (long p = A.inicioFila[i]; p < A.inicioFila[i + 1]; p++) {
+                y[i * k + v] += A.valor[p] * x[A.columna[p] * k + v];
+            }
+        }
+    }
+}
+
+/*
+ Repite en el proceso 0 los productos de forma secuencial, con las mismas
+ iteraciones y el mismo reescalado que el calculo paralelo, y deja en
+ 'comprueba' el resultado del ultimo. Devuelve el tiempo que ha tardado.
+ */
+template <typename T, typename Matriz>
+static double iteraSecuencial(Matriz &A, long n, int k, unsigned long long semilla, int iteraciones, double tolerancia,
+        T *comprueba) {
+    T *xSecuencial = new T [n * k]; // Vector de entrada de cada iteracion del algoritmo secuencial
+    generaVector(semilla, 0, n, k, xSecuencial);
+    cout << "Inicio algoritmo secuencial........" << endl;
+    double tInicio = MPI_Wtime(); // Tiempo real, como el paralelo
+    for (int iter = 0; iter < iteraciones; iter++) {
+        productoSecuencial(A, n, k, xSecuencial, comprueba);
+        if (iter + 1 < iteraciones) {
+            double diferencia = normalizaVector(comprueba, xSecuencial, n * k);
+            if (diferencia <= tolerancia) break;
+        }
+    }
+    double tSecuencial = MPI_Wtime() - tInicio;
+    cout << "........Fin algoritmo secuencial" << endl;
+    delete [] xSecuencial;
+    return tSecuencial;
+}
+
+// Resultados de la ultima repeticion que se comprueban y se muestran al terminar
+template <typename T>
+struct ResultadoPrograma {
+    const T *y; // y completo en el proceso 0 (con VERIFICA_COMPLETA)
+    const T *comprueba; // El mismo y calculado secuencialmente
+    double tSecuencial;
+    long erroresFreivalds; // Vectores incorrectos con VERIFICA_FREIVALDS...
+    double tComprobacion; // ...y tiempo de la comprobacion
+    long abft[2]; // Productos locales comprobados y fallos, de todos los procesos
+    int iteracionesRealizadas;
+    double tComputo; // Calculo local de todas las iteraciones
+    double tBucle; // Bucle iterativo, con las comunicaciones del vector
+    double tTotal; // Desde la carga de A hasta el final del bucle...
+    const char *total; // ...y lo que incluye
+    string nota; // Lineas que se muestran antes del veredicto (vacio = ninguna)
+};
+
+// Solo en el proceso 0: comprobacion, veredicto y tiempos
+template <typename T>
+static void informa(const ConfiguracionMxv &configuracion, const OpcionesPrograma &opciones, const ResultadoPrograma<T> &resultado) {
+    const long n = configuracion.n;
+    const int k = configuracion.k;
+    long errores = 0;
+    if (opciones.verificacion == VERIFICA_COMPLETA) {
+        T ySum = 0, compruebaSum = 0; // Para mostrar resultado de comprobación para valores de n > 24
+        cout << "El resultado obtenido y el esperado son:" << endl;
+        for (long i = 0; i < n * k; i++) {
+            ySum += resultado.y[i];
+            compruebaSum += resultado.comprueba[i];
+            if (n < 24) {
+                cout << "\t" << resultado.y[i] << "\t|\t" << resultado.comprueba[i] << endl;
+            }
+            if (!resultadosIguales(resultado.y[i], resultado.comprueba[i]))
+                errores++;
+        }
+        cout << "\tSUMA DE VECTORES: " << ySum << "\t|\t" << compruebaSum << endl;
+    } else if (opciones.verificacion == VERIFICA_FREIVALDS) {
+        errores += resultado.erroresFreivalds;
+        cout << "Comprobacion de Freivalds: " << k - resultado.erroresFreivalds << " de " << k << " vectores correctos en "
+                << resultado.tComprobacion << " segundos" << endl;
+    }
+    if (configuracion.abft) {
+        errores += resultado.abft[1];
+        cout << "Comprobacion ABFT: " << resultado.abft[1] << " fallos en " << resultado.abft[0] << " productos locales" << endl;
+    }
+    cout << resultado.nota;
+
+    if (errores) {
+        cout << "Hubo " << errores << " errores." << endl;
+        return;
+    }
+    if (opciones.verificacion == VERIFICA_NINGUNA && !configuracion.abft) {
+        cout << "Resultado sin comprobar (--verify none)" << endl;
+    } else {
+        cout << "No hubo errores" << endl;
+    }
+    cout << "El tiempo paralelo ha sido " << resultado.tComputo << " segundos." << endl;
+    if (opciones.verificacion == VERIFICA_COMPLETA) {
+        cout << "El tiempo secuencial ha sido " << resultado.tSecuencial << " segundos." << endl;
+        cout << "La ganancia ha sido " << resultado.tSecuencial / resultado.tComputo << endl;
+    }
+    if (opciones.iteraciones > 1) {
+        cout << "Iteraciones realizadas: " << resultado.iteracionesRealizadas << " de " << opciones.iteraciones << endl;
+    }
+    cout << "El tiempo total (" << resultado.total << ") ha sido " << resultado.tTotal << " segundos." << endl;
+    if (opciones.iteraciones > 1 || k > 1) {
+        cout << "Rendimiento: " << (double) resultado.iteracionesRealizadas * k / resultado.tBucle << " productos matriz-vector por segundo" << endl;
+    }
+}
+
+/*
+ Producto denso con elementos de tipo T y la matriz guardada en el tipo S. El
+ reparto y los productos los hace MatrizDistribuida; aqui quedan los datos del
+ proceso 0, las repeticiones y la comprobacion.
+ */
+template <typename T, typename S>
+static void ejecutaDensa(ConfiguracionMxv configuracion, const OpcionesPrograma &opciones) {
+    int numeroProcesadores, idProceso;
+    MPI_Comm_size(MPI_COMM_WORLD, &numeroProcesadores);
+    MPI_Comm_rank(MPI_COMM_WORLD, &idProceso);
+    const long n = configuracion.n;
+    const int k = configuracion.k;
+    const unsigned long long semilla = configuracion.semilla;
+    const char *fichero = configuracion.fichero.empty() ? NULL : configuracion.fichero.c_str();
+
+    // Distribucion elegida con las sondas o leida del fichero de cacheAjuste
+    if (opciones.autoajuste) {
+        vector<DisposicionMxv> candidatos;
+        DisposicionMxv eleccion = eligeDisposicion<T, S>(n, k, configuracion.yRepartido, nombreTipoAlmacen(opciones.tipo, opciones.almacen),
+                opciones.cacheAjuste, MPI_COMM_WORLD, candidatos);
+        configuracion.distribucion = eleccion.distribucion;
+        configuracion.filasMalla = eleccion.filasMalla;
+        configuracion.columnasMalla = eleccion.columnasMalla;
+        if (idProceso == 0) {
+            for (size_t c = 0; c < candidatos.size(); c++) {
+                cout << "Estimacion " << nombreDistribucion(candidatos[c].distribucion) << " " << candidatos[c].filasMalla << " x "
+                        << candidatos[c].columnasMalla << ": " << candidatos[c].segundos << " segundos por producto" << endl;
+            }
+            cout << "Distribucion elegida: " << nombreDistribucion(eleccion.distribucion) << " " << eleccion.filasMalla << " x "
+                    << eleccion.columnasMalla << (candidatos.empty() ? " (de " + opciones.cacheAjuste + ")" : string("")) << endl;
+        }
+    }
+    const DistribucionMatriz distribucion = configuracion.distribucion;
+
+    MatrizDistribuida<T, S> matriz(MPI_COMM_WORLD);
+    matriz.planifica(configuracion);
+    MedidorFases fases;
+    matriz.anotaFases(&fases);
+    const long *primeraFila = matriz.primeraFila(); // Primera fila de cada procesador
+    const vector<double> &pesos = matriz.pesos();
+
+    S       *A = NULL; // Matriz a multiplicar, solo en el proceso 0 y solo si no se genera en cada proceso
+    T       *x, // Vector que vamos a multiplicar (con yRepartido, el trozo de cada proceso)
+            *y, // Vector donde almacenamos el resultado (con yRepartido, el trozo de cada proceso)
+            *yRecogido, // y completo en el proceso 0
+            *comprueba = NULL; // Resultado calculado secuencialmente, debe ser igual a 'y'
+
+    // Con yRepartido cada proceso tiene solo su trozo de x e y; si no, x e y solo estan en el proceso 0
+    const long primeraPosicion = matriz.primeraPosicion(), posiciones = matriz.posiciones();
+    if (configuracion.yRepartido) {
+        x = new T [posiciones * k + 1];
+        y = new T [posiciones * k + 1];
+        yRecogido = (idProceso == 0) ? new T [n * k] : NULL;
+    } else {
+        x = (idProceso == 0) ? new T [n * k] : NULL; // Los k vectores tienen el mismo tamaño que una fila de la matriz
+        y = (idProceso == 0) ? new T [n * k] : NULL;
+        yRecogido = y;
+    }
+
+    ResultadoPrograma<T> resultado = ResultadoPrograma<T>();
+    if (idProceso == 0) {
+        // Rellenamos 'A' con valores aleatorios ('x' se genera en cada repeticion)
+        cout << "Inicio carga de datos........" << endl;
+        if (configuracion.carga == CARGA_RAIZ) {
+            A = new S [n * n];
+            generaBloque(semilla, n, 0, n, 0, n, A, n);
+        }
+        cout << "........Fin carga de datos" << endl;
+
+        // Sin matriz completa, se genera o se lee del fichero cada fila cuando se necesita
+        LectorFilas<S> lector(A, n, semilla, fichero);
+
+        if (n < 24) {
+            cout << "La matriz y el vector generados son " << endl;
+            for (long i = 0; i < n; i++) {
+                for (long j = 0; j < n; j++) {
+                    if (j == 0) cout << "[";
+                    cout << lector.fila(i)[j];
+                    if (j == n - 1) cout << "]";
+                    else cout << "  ";
+                }
+                cout << "\t  [";
+                for (int v = 0; v < k; v++) {
+                    cout << (v ? "  " : "") << valorVector<T>(semilla, i, v);
+                }
+                cout << "]" << endl;
+            }
+            cout << "\n";
+        }
+
+        if (distribucion == DISTRIBUCION_FILAS) {
+            if (!pesos.empty()) {
+                cout << "Capacidad relativa de cada procesador: [";
+                for (int i = 0; i < numeroProcesadores; i++) {
+                    cout << " " << pesos[i];
+                }
+                cout << " ]" << endl;
+            }
+            cout << "Filas de cada procesador: [";
+            for (int i = 0; i < numeroProcesadores; i++) {
+                cout << " " << primeraFila[i + 1] - primeraFila[i];
+            }
+            cout << " ]" << endl;
+            if (configuracion.xCompartido) {
+                cout << "Nodos: " << matriz.nodos() << " (una copia de x e y por nodo en lugar de " << numeroProcesadores << ")" << endl;
+            }
+            cout << "Elementos que procesa cada procesador: [";
+            for (int i = 0; i < numeroProcesadores; i++) {
+                cout << " " << (primeraFila[i + 1] - primeraFila[i]) * n;
+            }
+            cout << " ]" << endl;
+
+            // Desplazamiento en vectores, en filas
+            cout << "Desplazamiento de envío para cada vector: [";
+            for (int i = 0; i < numeroProcesadores; i++) {
+                cout << " " << primeraFila[i] * n;
+            }
+            cout << " ]" << endl;
+            cout << "Desplazamiento de recepción para cada vector: [";
+            for (int i = 0; i < numeroProcesadores; i++) {
+                cout << " " << primeraFila[i] * k;
+            }
+            cout << " ]" << endl;
+        } else {
+            cout << "Malla de procesos: " << matriz.filasMalla() << " x " << matriz.columnasMalla()
+                    << (configuracion.topologia && distribucion == DISTRIBUCION_BLOQUES ? ", colocada por nodos (MPI_Cart_create)" : "") << endl;
+        }
+
+        if (opciones.verificacion == VERIFICA_COMPLETA) {
+            comprueba = new T [n * k];
+            resultado.tSecuencial = iteraSecuencial(lector, n, k, semilla, opciones.iteraciones, opciones.tolerancia, comprueba);
+        }
+    }
+
+    // Compresion y filas de control de la matriz completa, una sola vez y fuera del reparto que se mide
+    matriz.prepara(A);
+    if (idProceso == 0 && configuracion.comprimir) {
+        double bytes = (double) n * n * sizeof(S);
+        cout << "Reparto de A comprimido: " << matriz.bytesComprimidos() << " bytes en lugar de " << bytes
+                << " (" << bytes / matriz.bytesComprimidos() << " veces menos)" << endl;
+    }
+
+    double tTotalIni = 0, tBucleIni = 0, tBucleFin = 0;
+    long bytesAntesProductos = 0; // Bytes de A leidos del fichero antes de los productos de la repeticion (CARGA_FLUJO)
+    for (int repeticion = 0; repeticion < opciones.calentamiento + opciones.repeticiones; repeticion++) {
+        fases.activa(repeticion >= opciones.calentamiento);
+        // Con yRepartido cada proceso genera su trozo del x inicial en lugar de recibirlo
+        if (configuracion.yRepartido) {
+            generaVector(semilla, primeraPosicion, posiciones, k, x);
+        } else if (idProceso == 0) {
+            generaVector(semilla, 0, n, k, x);
+        }
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        tTotalIni = MPI_Wtime();
+        // Con reparto segmentado la matriz se envia dentro de la primera iteracion
+        matriz.reparte(A);
+        bytesAntesProductos = matriz.bytesLeidos();
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        tBucleIni = MPI_Wtime();
+        resultado.iteracionesRealizadas = matriz.itera(x, y, opciones.iteraciones, opciones.tolerancia);
+        tBucleFin = MPI_Wtime();
+    }
+    resultado.tComputo = matriz.tiempoIteraciones();
+    resultado.tBucle = tBucleFin - tBucleIni;
+    resultado.tTotal = tBucleFin - tTotalIni;
+    resultado.total = "reparto de A, calculo y recogida";
+
+    // Con CARGA_FLUJO, bytes de A leidos del fichero por todos los procesos en los productos de la ultima repeticion
+    long misBytesFlujo = matriz.bytesLeidos() - bytesAntesProductos, bytesFlujo = 0;
+    if (configuracion.carga == CARGA_FLUJO) {
+        MPI_Reduce(&misBytesFlujo, &bytesFlujo, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        ostringstream nota;
+        nota << "Lectura por paneles de " << configuracion.filasPanel << " filas: " << bytesFlujo << " bytes del fichero en "
+                << resultado.tComputo << " segundos (" << bytesFlujo / resultado.tComputo / 1e6 << " MB/s)" << endl;
+        resultado.nota = nota.str();
+    }
+
+    string descomposicion = distribucion == DISTRIBUCION_FILAS ? "1d" : distribucion == DISTRIBUCION_COLUMNAS ? "1d_columnas" : "2d";
+    if (configuracion.yRepartido) {
+        descomposicion += "_y_repartido";
+    }
+    DescripcionEjecucion ejecucion = {descomposicion, n, numeroProcesadores, hilosNucleo(),
+            nombreTipoAlmacen(opciones.tipo, opciones.almacen), k};
+    resumePerfil(opciones.traza, MPI_COMM_WORLD);
+    fases.resume(ejecucion, opciones.csv, opciones.json, MPI_COMM_WORLD);
+
+    // Con yRepartido el resultado solo se recoge para compararlo con el secuencial
+    if (configuracion.yRepartido && opciones.verificacion == VERIFICA_COMPLETA) {
+        matriz.recogeY(y, yRecogido);
+    }
+
+    // Freivalds con el y recogido en el proceso 0, o con el trozo de cada proceso si y sigue repartido
+    double tComprobacion = MPI_Wtime();
+    if (opciones.verificacion == VERIFICA_FREIVALDS) {
+        resultado.erroresFreivalds = matriz.compruebaFreivalds(semilla, y);
+    }
+    resultado.tComprobacion = MPI_Wtime() - tComprobacion;
+    long abft[2] = {matriz.productosComprobados(), matriz.fallosAbft()};
+    if (configuracion.abft) {
+        MPI_Reduce(abft, resultado.abft, 2, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    }
+
+    if (idProceso == 0) {
+        resultado.y = yRecogido;
+        resultado.comprueba = comprueba;
+        informa(configuracion, opciones, resultado);
+    }
+
+    if (yRecogido != y) {
+        delete [] yRecogido;
+    }
+    delete [] comprueba;
+    delete [] x;
+    delete [] y;
+    delete [] A;
+}
+
+/*
+ Producto disperso (noNulosFila > 0) con MatrizDispersa: no hay matriz
+ completa ni difusion de x, y y queda repartido como el siguiente x. Sin
+ yRepartido se recoge al final en el proceso 0.
+ */
+template <typename T>
+static void ejecutaDispersa(const ConfiguracionMxv &configuracion, const OpcionesPrograma &opciones) {
+    int numeroProcesadores, idProceso;
+    MPI_Comm_size(MPI_COMM_WORLD, &numeroProcesadores);
+    MPI_Comm_rank(MPI_COMM_WORLD, &idProceso);
+    const long n = configuracion.n;
+    const int k = configuracion.k;
+    const unsigned long long semilla = configuracion.semilla;
+
+    ResultadoPrograma<T> resultado = ResultadoPrograma<T>();
+    T *comprueba = NULL;
+    if (idProceso == 0 && opciones.verificacion == VERIFICA_COMPLETA) {
+        // Algoritmo secuencial con la matriz dispersa completa
+        MatrizCSR<T> completa;
+        generaFilasDispersas(semilla, n, configuracion.noNulosFila, 0, n, completa);
+        comprueba = new T [n * k];
+        resultado.tSecuencial = iteraSecuencial(completa, n, k, semilla, opciones.iteraciones, opciones.tolerancia, comprueba);
+    }
+
+    // La construccion de A y del plan del halo se mide una sola vez, aunque se pidan repeticiones
+    MedidorFases fases;
+    MatrizDispersa<T> matriz(MPI_COMM_WORLD);
+    matriz.anotaFases(&fases);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double tTotalIni = MPI_Wtime(), tBucleIni = 0, tBucleFin = 0;
+    matriz.planifica(configuracion);
+
+    const long primeraPosicion = matriz.primeraPosicion(), posiciones = matriz.posiciones();
+    T *x = new T [posiciones * k + 1];
+    T *y = new T [posiciones * k + 1];
+    T *yRecogido = (idProceso == 0) ? new T [n * k] : NULL;
+    for (int repeticion = 0; repeticion < opciones.calentamiento + opciones.repeticiones; repeticion++) {
+        fases.activa(repeticion >= opciones.calentamiento);
+        generaVector(semilla, primeraPosicion, posiciones, k, x);
+        MPI_Barrier(MPI_COMM_WORLD);
+        tBucleIni = MPI_Wtime();
+        resultado.iteracionesRealizadas = matriz.itera(x, y, opciones.iteraciones, opciones.tolerancia);
+        tBucleFin = MPI_Wtime();
+    }
+    resultado.tComputo = matriz.tiempoIteraciones();
+    resultado.tBucle = tBucleFin - tBucleIni;
+    resultado.tTotal = tBucleFin - tTotalIni;
+    resultado.total = "construccion de A y del halo, calculo e intercambios";
+
+    // Con yRepartido, y solo se recoge si se compara con el calculo secuencial
+    if (!configuracion.yRepartido || opciones.verificacion == VERIFICA_COMPLETA) {
+        matriz.recogeY(y, yRecogido);
+    }
+    DescripcionEjecucion ejecucion = {"1d_disperso", n, numeroProcesadores, hilosNucleo(), nombreTipoDato(opciones.tipo), k};
+    resumePerfil(opciones.traza, MPI_COMM_WORLD);
+    fases.resume(ejecucion, opciones.csv, opciones.json, MPI_COMM_WORLD);
+    long datosReparto[2] = {matriz.noNulos(), matriz.fantasmas()};
+    vector<long> repartoTodos(2 * numeroProcesadores);
+    MPI_Gather(datosReparto, 2, MPI_LONG, &repartoTodos[0], 2, MPI_LONG, 0, MPI_COMM_WORLD);
+
+    double tComprobacion = MPI_Wtime();
+    if (opciones.verificacion == VERIFICA_FREIVALDS) {
+        resultado.erroresFreivalds = matriz.compruebaFreivalds(semilla, y);
+    }
+    resultado.tComprobacion = MPI_Wtime() - tComprobacion;
+    long abft[2] = {matriz.productosComprobados(), matriz.fallosAbft()};
+    if (configuracion.abft) {
+        MPI_Reduce(abft, resultado.abft, 2, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    }
+
+    if (idProceso == 0) {
+        const long *inicio = matriz.primeraFila();
+        long totalNoNulos = 0, totalFantasmas = 0;
+        cout << "Filas de cada procesador: [";
+        for (int r = 0; r < numeroProcesadores; r++) {
+            cout << " " << inicio[r + 1] - inicio[r];
+        }
+        cout << " ]" << endl;
+        cout << "No nulos de cada procesador: [";
+        for (int r = 0; r < numeroProcesadores; r++) {
+            cout << " " << repartoTodos[2 * r];
+            totalNoNulos += repartoTodos[2 * r];
+            totalFantasmas += repartoTodos[2 * r + 1];
+        }
+        cout << " ] de " << totalNoNulos << " (" << (double) totalNoNulos / n << " por fila)" << endl;
+        cout << "Elementos de x recibidos por iteracion: " << totalFantasmas * k << " (con MPI_Bcast serian " << n * k * (numeroProcesadores - 1) << ")" << endl;
+
+        resultado.y = yRecogido;
+        resultado.comprueba = comprueba;
+        informa(configuracion, opciones, resultado);
+    }
+
+    delete [] comprueba;
+    delete [] x;
+    delete [] y;
+    delete [] yRecogido;
+}
+
+void ejecutaPrograma(const ConfiguracionMxv &configuracion, const OpcionesPrograma &opciones) {
+    int idProceso;
+    MPI_Comm_rank(MPI_COMM_WORLD, &idProceso);
+
+    // Todos los procesos usan la semilla del proceso 0
+    ConfiguracionMxv comun = configuracion;
+    MPI_Bcast(&comun.semilla, 1, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+
+    if (opciones.hilos > 0) {
+        fijaHilos(opciones.hilos);
+    }
+
+    if (idProceso == 0) {
+        cout << "Tipo de dato: " << nombreTipoAlmacen(opciones.tipo, opciones.almacen) << ", nucleo de calculo: " << nombreIsa(isaNucleo())
+                << ", hilos por proceso: " << hilosNucleo() << endl;
+    }
+
+    // Con perfil se anotan las operaciones MPI y el calculo desde aqui hasta el resumen
+    if (opciones.perfil) {
+        iniciaPerfil(!opciones.traza.empty());
+    }
+
+    if (comun.noNulosFila > 0) {
+        switch (opciones.tipo) {
+            case TIPO_INT32: ejecutaDispersa<int>(comun, opciones); break;
+            case TIPO_INT64: ejecutaDispersa<long>(comun, opciones); break;
+            case TIPO_FLOAT: ejecutaDispersa<float>(comun, opciones); break;
+            case TIPO_DOUBLE: ejecutaDispersa<double>(comun, opciones); break;
+            default: break;
+        }
+        return;
+    }
+
+    // Solo se instancian las combinaciones de tipo y almacenamiento que admite almacenValido
+    switch (opciones.tipo) {
+        case TIPO_INT32:
+            if (opciones.almacen == TIPO_INT16) ejecutaDensa<int, short>(comun, opciones);
+            else ejecutaDensa<int, int>(comun, opciones);
+            break;
+        case TIPO_INT64:
+            if (opciones.almacen == TIPO_INT16) ejecutaDensa<long, short>(comun, opciones);
+            else if (opciones.almacen == TIPO_INT32) ejecutaDensa<long, int>(comun, opciones);
+            else ejecutaDensa<long, long>(comun, opciones);
+            break;
+        case TIPO_FLOAT:
+            if (opciones.almacen == TIPO_INT16) ejecutaDensa<float, short>(comun, opciones);
+            else ejecutaDensa<float, float>(comun, opciones);
+            break;
+        case TIPO_DOUBLE:
+            if (opciones.almacen == TIPO_INT16) ejecutaDensa<double, short>(comun, opciones);
+            else if (opciones.almacen == TIPO_INT32) ejecutaDensa<double, int>(comun, opciones);
+            else if (opciones.almacen == TIPO_FLOAT) ejecutaDensa<double, float>(comun, opciones);
+            else ejecutaDensa<double, double>(comun, opciones);
+            break;
+        default: break;
+    }
+}
@@ -0,0 +1,78 @@
+/*
+ ============================================================================
+ Name        : programa_mxv.h
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Ejecucion completa de matriz_x_vector.cpp y
+    bidimensional_matriz_x_vector.cpp en libmxv, para que los programas solo
+    lean y validen sus opciones: ejecutaPrograma() genera los datos, hace las
+    repeticiones de la iteracion de potencia con MatrizDistribuida (o con
+    MatrizDispersa si hay noNulosFila), comprueba el resultado y muestra el
+    resumen.
+
+ Iteracion de potencia: la matriz se reparte una sola vez y se hacen hasta
+ 'iteraciones' productos, moviendo solo el vector. Entre iteraciones el
+ resultado se reescala al rango inicial de x y se usa como nuevo x, y con
+ tolerancia >= 0 se para en cuanto la maxima diferencia entre dos vectores
+ consecutivos es <= tolerancia. Con yRepartido cada proceso genera su trozo
+ del x inicial con la semilla y y solo se recoge al final para
+ VERIFICA_COMPLETA; Freivalds lo comprueba repartido. En el producto disperso
+ y ya queda repartido y yRepartido solo evita esa recogida final.
+
+ Con CARGA_FLUJO se muestra tambien el ritmo de lectura del fichero (los
+ bytes que leen todos los procesos en los productos de la ultima repeticion,
+ entre el tiempo de esos productos), que con paneles grandes debe acercarse
+ al del disco.
+
+ Con calentamiento W y repeticiones R el reparto de A y el bucle iterativo se
+ repiten W veces sin medir y R veces midiendo (fases_mxv.h), y csv y json
+ añaden el resumen de las fases a esos ficheros. Los resultados que se
+ comprueban son los de la ultima repeticion.
+
+ Para comprobar el resultado, el proceso 0 repite el producto de forma
+ secuencial (VERIFICA_COMPLETA), con las mismas iteraciones y el mismo
+ reescalado. Con n grande eso tarda mas que el calculo paralelo;
+ VERIFICA_FREIVALDS comprueba y con proyecciones aleatorias (r^T y = (r^T A) x,
+ calculado de forma repartida) y abft comprueba cada producto local con una
+ fila de control por bloque (verificacion_mxv.h).
+ ============================================================================
+ */
+
+#ifndef PROGRAMA_MXV_H
+#define PROGRAMA_MXV_H
+
+#include <string>
+
+#include "distribuida_mxv.h"
+#include "utilidades_mxv.h"
+#include "verificacion_mxv.h"
+
+// Opciones de la ejecucion que no son parte de la ConfiguracionMxv
+struct OpcionesPrograma {
+    OpcionesPrograma() : tipo(TIPO_INT64), almacen(TIPO_INT64), iteraciones(1), tolerancia(-1), hilos(0), calentamiento(0),
+            repeticiones(1), verificacion(VERIFICA_COMPLETA), perfil(false), autoajuste(false) {}
+
+    TipoDato tipo; // Tipo de los elementos de la matriz y los vectores
+    TipoDato almacen; // Tipo en el que se guarda y se reparte la matriz (el de los elementos o uno mas estrecho)
+    int iteraciones; // Numero maximo de productos con la matriz residente
+    double tolerancia; // Criterio de parada por convergencia (< 0 desactivado)
+    int hilos; // Hilos por proceso para el calculo local (0 = los de OMP_NUM_THREADS)
+    int calentamiento; // Repeticiones previas sin medir
+    int repeticiones; // Repeticiones medidas (reparto de A y bucle iterativo completos)
+    std::string csv; // Fichero CSV al que se añade el resumen de las fases (vacio = ninguno)
+    std::string json; // Fichero JSON Lines al que se añade el resumen de las fases
+    Verificacion verificacion; // Comprobacion del resultado: secuencial completa, Freivalds o ninguna
+    bool perfil; // Perfil por proceso de las operaciones MPI y del calculo (perfil_mxv.h)
+    std::string traza; // Fichero de la traza de eventos (vacio = sin traza)
+    bool autoajuste; // Elegir la distribucion con sondas y el modelo de coste (autoajuste_mxv.h)
+    std::string cacheAjuste; // Fichero con las distribuciones ya elegidas (vacio = sin fichero)
+};
+
+/*
+ Lo llaman todos los procesos de MPI_COMM_WORLD con las mismas opciones, entre
+ MPI_Init y MPI_Finalize. La semilla que se usa es la del proceso 0.
+ */
+void ejecutaPrograma(const ConfiguracionMxv &configuracion, const OpcionesPrograma &opciones);
+
+#endif
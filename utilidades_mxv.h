@@ -0,0 +1,226 @@
+/*
+ ============================================================================
+ Name        : utilidades_mxv.h
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Utilidades comunes a matriz_x_vector.cpp y
+    bidimensional_matriz_x_vector.cpp: tipos de dato admitidos (--dtype y
+    --storage) y su equivalente MPI, reparto de filas entre procesos, comparacion de resultados
+    y reescalado del vector entre iteraciones.
+ ============================================================================
+ */
+
+#ifndef UTILIDADES_MXV_H
+#define UTILIDADES_MXV_H
+
+#include <cmath>
+#include <mpi.h>
+#include <string>
+#include <type_traits>
+
+// TIPO_INT16 solo se admite como tipo de almacenamiento de la matriz (--storage)
+enum TipoDato { TIPO_INT32 = 1, TIPO_INT64 = 2, TIPO_FLOAT = 3, TIPO_DOUBLE = 4, TIPO_INT16 = 5 };
+
+inline const char *nombreTipoDato(TipoDato tipo) {
+    switch (tipo) {
+        case TIPO_INT16: return "int16";
+        case TIPO_INT32: return "int32";
+        case TIPO_INT64: return "int64";
+        case TIPO_FLOAT: return "float";
+        default: return "double";
+    }
+}
+
+inline bool tipoDatoDesdeNombre(const std::string &nombre, TipoDato &tipo) {
+    for (int t = TIPO_INT32; t <= TIPO_DOUBLE; t++) {
+        if (nombre == nombreTipoDato((TipoDato) t)) {
+            tipo = (TipoDato) t;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline long bytesTipoDato(TipoDato tipo) {
+    switch (tipo) {
+        case TIPO_INT16: return 2;
+        case TIPO_INT32: case TIPO_FLOAT: return 4;
+        default: return 8;
+    }
+}
+
+// Tipo de almacenamiento de la matriz (--storage): int16 o cualquiera de los de --dtype
+inline bool almacenDesdeNombre(const std::string &nombre, TipoDato &almacen) {
+    if (nombre == nombreTipoDato(TIPO_INT16)) {
+        almacen = TIPO_INT16;
+        return true;
+    }
+    return tipoDatoDesdeNombre(nombre, almacen);
+}
+
+/*
+ La matriz de elementos de tipo 'tipo' puede guardarse en el propio tipo o en
+ uno mas estrecho: un entero en otro entero y un real en un entero o en float,
+ pero no un entero en float.
+ */
+inline bool almacenValido(TipoDato almacen, TipoDato tipo) {
+    bool enteroEnReal = (almacen == TIPO_FLOAT || almacen == TIPO_DOUBLE) && (tipo == TIPO_INT32 || tipo == TIPO_INT64);
+    return almacen == tipo || (bytesTipoDato(almacen) < bytesTipoDato(tipo) && !enteroEnReal);
+}
+
+// Nombre del tipo de los elementos y, si la matriz se guarda en otro, del de la matriz ("int64/int16")
+inline std::string nombreTipoAlmacen(TipoDato tipo, TipoDato almacen) {
+    std::string nombre = nombreTipoDato(tipo);
+    if (almacen != tipo) {
+        nombre = nombre + "/" + nombreTipoDato(almacen);
+    }
+    return nombre;
+}
+
+// Tipo MPI equivalente a cada tipo de elemento
+template <typename T> MPI_Datatype tipoMPI();
+template <> inline MPI_Datatype tipoMPI<short>() { return MPI_SHORT; }
+template <> inline MPI_Datatype tipoMPI<int>() { return MPI_INT; }
+template <> inline MPI_Datatype tipoMPI<long>() { return MPI_LONG; }
+template <> inline MPI_Datatype tipoMPI<float>() { return MPI_FLOAT; }
+template <> inline MPI_Datatype tipoMPI<double>() { return MPI_DOUBLE; }
+
+/*
+ Reparte n filas entre P procesos en bloques consecutivos, proporcionales a la
+ capacidad de cada proceso ('pesos', P valores; NULL si todos son iguales).
+ Cada proceso recibe la parte entera de lo que le corresponde y las filas que
+ sobran se dan, de una en una, a los procesos con mayor parte fraccionaria: con
+ pesos iguales ningun proceso tiene mas de una fila de diferencia con otro.
+ Devuelve en 'inicio' (P + 1 posiciones) la primera fila de cada proceso.
+ */
+inline void repartoFilas(long n, int P, const double *pesos, long *inicio) {
+    double total = 0;
+    for (int r = 0; r < P; r++) {
+        total += pesos ? pesos[r] : 1;
+    }
+    long *filas = new long[P];
+    double *resto = new double[P];
+    long asignadas = 0;
+    for (int r = 0; r < P; r++) {
+        double ideal = n * (pesos ? pesos[r] : 1) / total;
+        filas[r] = (long) ideal;
+        resto[r] = ideal - filas[r];
+        asignadas += filas[r];
+    }
+    // Las que sobran, al mayor resto (a igualdad, al proceso de menor rango)
+    for (; asignadas < n; asignadas++) {
+        int elegido = 0;
+        for (int r = 1; r < P; r++) {
+            if (resto[r] > resto[elegido]) elegido = r;
+        }
+        filas[elegido]++;
+        resto[elegido] = -1;
+    }
+    inicio[0] = 0;
+    for (int r = 0; r < P; r++) {
+        inicio[r + 1] = inicio[r] + filas[r];
+    }
+    delete [] filas;
+    delete [] resto;
+}
+
+/*
+ Compara un resultado con el calculado secuencialmente. Los enteros deben
+ coincidir exactamente; en coma flotante el nucleo suma en otro orden que el
+ bucle secuencial, asi que se admite un error relativo pequeño.
+ */
+template <typename T>
+bool resultadosIguales(T obtenido, T esperado) {
+    if (std::is_integral<T>::value) {
+        return obtenido == esperado;
+    }
+    double tolerancia = std::is_same<T, float>::value ? 1e-3 : 1e-9;
+    double escala = std::fabs((double) esperado) > 1 ? std::fabs((double) esperado) : 1;
+    return std::fabs((double) obtenido - (double) esperado) <= tolerancia * escala;
+}
+
+// Maximo valor absoluto de 'y'
+template <typename T>
+T maximoAbsoluto(const T *y, long n) {
+    T maximo = 0;
+    for (long i = 0; i < n; i++) {
+        if (std::abs(y[i]) > maximo) maximo = std::abs(y[i]);
+    }
+    return maximo;
+}
+
+// Valor reescalado de un elemento de 'y' al rango [0, 100) en el que se genera 'x'
+template <typename T>
+T valorReescalado(T y, T maximo) {
+    if (maximo == 0) {
+        return 0;
+    }
+    if (std::is_integral<T>::value) {
+        return (T) (((long long) y * 99) / (long long) maximo);
+    }
+    return (y * 99) / maximo;
+}
+
+/*
+ Maxima diferencia (en valor absoluto) entre 'y' reescalado con 'maximo' y 'x',
+ sin modificar 'x': asi se decide si se sigue iterando sin perder el vector de
+ entrada del ultimo producto, que hace falta para comprobarlo.
+ */
+template <typename T>
+double diferenciaReescalado(const T *y, const T *x, long n, T maximo) {
+    double diferencia = 0;
+    for (long i = 0; i < n; i++) {
+        double cambio = std::fabs((double) valorReescalado(y[i], maximo) - (double) x[i]);
+        if (cambio > diferencia) {
+            diferencia = cambio;
+        }
+    }
+    return diferencia;
+}
+
+/*
+ Reescala 'y' al rango [0, 100) en el que se genera 'x', tomando 'maximo' como el
+ mayor valor absoluto, y lo guarda en 'x'. Cuando el vector esta repartido,
+ 'maximo' es el de todo el vector (no solo el del trozo local).
+ Devuelve la maxima diferencia (en valor absoluto) entre el nuevo 'x' y el anterior.
+ */
+template <typename T>
+double reescalaVector(const T *y, T *x, long n, T maximo) {
+    double diferencia = diferenciaReescalado(y, x, n, maximo);
+    for (long i = 0; i < n; i++) {
+        x[i] = valorReescalado(y[i], maximo);
+    }
+    return diferencia;
+}
+
+/*
+ Reescala 'y' al rango [0, 100) en el que se genera 'x' y lo guarda en 'x', para
+ que los valores no crezcan sin limite de una iteracion a la siguiente.
+ Devuelve la maxima diferencia (en valor absoluto) entre el nuevo 'x' y el anterior.
+ */
+template <typename T>
+double normalizaVector(const T *y, T *x, long n) {
+    return reescalaVector(y, x, n, maximoAbsoluto(y, n));
+}
+
+/*
+ Reescalado de un vector repartido: 'y' y 'x' son los 'n' elementos de cada
+ proceso, y el maximo y la diferencia son los de todo el vector (MPI_Allreduce).
+ 'x' solo se sustituye si se sigue iterando (diferencia > 'tolerancia'). Lo
+ llaman todos los procesos de 'comunicador'; devuelve si hay que seguir.
+ */
+template <typename T>
+bool reescalaRepartido(const T *y, T *x, long n, double tolerancia, MPI_Comm comunicador) {
+    T maximoLocal = maximoAbsoluto(y, n), maximo;
+    MPI_Allreduce(&maximoLocal, &maximo, 1, tipoMPI<T>(), MPI_MAX, comunicador);
+    double diferenciaLocal = diferenciaReescalado(y, x, n, maximo), diferencia;
+    MPI_Allreduce(&diferenciaLocal, &diferencia, 1, MPI_DOUBLE, MPI_MAX, comunicador);
+    if (diferencia <= tolerancia) {
+        return false;
+    }
+    reescalaVector(y, x, n, maximo);
+    return true;
+}
+
+#endif
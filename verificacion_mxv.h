@@ -0,0 +1,243 @@
+/*
+ ============================================================================
+ Name        : verificacion_mxv.h
+ Author      : Jose Saldaña Mercado
+ Version     :
+ Copyright   : GNU Open Souce and Free license
+ Description : Comprobacion barata del resultado para matriz_x_vector.cpp y
+    bidimensional_matriz_x_vector.cpp, sin repetir el producto en el proceso 0.
+
+ --verify freivalds (algoritmo de Freivalds): para un vector aleatorio r, si
+ y = A x entonces r^T y = (r^T A) x. Cada proceso calcula w = r^T A con su
+ bloque de A (el mismo coste que un producto, repartido; MatrizDistribuida y
+ MatrizDispersa lo guardan hasta que cambian la matriz o la semilla, asi que
+ con --stream el fichero se lee una vez) y, para comprobar un resultado, w^T x
+ con su trozo de x; el proceso 0 suma las contribuciones y las compara con
+ r^T y: O(n) por producto en lugar de O(n^2) en un solo proceso.
+ En enteros se calcula modulo 2^32 o 2^64 (como el propio producto cuando se
+ desborda), con r en todo el rango; en coma flotante en double, con r en [0, 1).
+
+ --abft (tolerancia a fallos basada en el algoritmo): cada bloque de A lleva una
+ fila de control con la suma de sus columnas, calculada en el origen del bloque
+ (el proceso 0 cuando tiene la matriz completa, que la envia junto con el
+ bloque). Despues de cada producto local, la suma de los elementos de y del
+ bloque debe coincidir con el producto de la fila de control por x, asi que un
+ error en el calculo (o en el bloque recibido) se detecta en cada iteracion con
+ un coste de O(n) por proceso.
+ ============================================================================
+ */
+
+#ifndef VERIFICACION_MXV_H
+#define VERIFICACION_MXV_H
+
+#include <cmath>
+#include <limits>
+#include <mpi.h>
+#include <type_traits>
+#include <vector>
+
+#include "csr_mxv.h"
+#include "generador_mxv.h"
+#include "kernel_mxv.h"
+#include "utilidades_mxv.h"
+
+enum Verificacion { VERIFICA_COMPLETA, VERIFICA_FREIVALDS, VERIFICA_NINGUNA };
+
+inline const char *nombreVerificacion(Verificacion verificacion) {
+    switch (verificacion) {
+        case VERIFICA_COMPLETA: return "full";
+        case VERIFICA_FREIVALDS: return "freivalds";
+        default: return "none";
+    }
+}
+
+inline bool verificacionDesdeNombre(const std::string &nombre, Verificacion &verificacion) {
+    for (int v = VERIFICA_COMPLETA; v <= VERIFICA_NINGUNA; v++) {
+        if (nombre == nombreVerificacion((Verificacion) v)) {
+            verificacion = (Verificacion) v;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Tipo en el que se hacen las sumas de Freivalds: enteros sin signo del mismo ancho o double
+template <typename T> struct TipoControl { typedef double tipo; };
+template <> struct TipoControl<int> { typedef unsigned int tipo; };
+template <> struct TipoControl<long> { typedef unsigned long tipo; };
+
+template <typename T> MPI_Datatype tipoMPIControl() { return MPI_DOUBLE; }
+template <> inline MPI_Datatype tipoMPIControl<int>() { return MPI_UNSIGNED; }
+template <> inline MPI_Datatype tipoMPIControl<long>() { return MPI_UNSIGNED_LONG; }
+
+/*
+ Error relativo admitido entre dos sumas de 'terminos' productos calculadas en
+ distinto orden: ninguno en enteros y unos pocos epsilon del tipo por la raiz
+ del numero de terminos en coma flotante (el error de redondeo de una suma larga
+ crece como un paseo aleatorio), mucho menos que lo que admite
+ resultadosIguales para un solo elemento.
+ */
+template <typename T>
+double toleranciaSuma(long terminos) {
+    if (std::is_integral<T>::value) {
+        return 0;
+    }
+    return 16 * std::numeric_limits<T>::epsilon() * std::sqrt((double) terminos);
+}
+
+// Elemento i del vector aleatorio r (otra secuencia que la de la matriz y x)
+template <typename T>
+typename TipoControl<T>::tipo pesoFreivalds(unsigned long long semilla, long i) {
+    unsigned long long aleatorio = aleatorioEn(semilla ^ 0xF4E1BA1D5ULL, i);
+    if (std::is_integral<T>::value) {
+        return (typename TipoControl<T>::tipo) aleatorio;
+    }
+    return (typename TipoControl<T>::tipo) (aleatorio >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ w = r^T A del bloque de 'filas' x 'columnas' (distancia 'ld') cuya primera fila
+ es la 'fila0' de la matriz, guardado en el tipo S (--storage) para elementos
+ de tipo T. Los hilos se reparten las columnas.
+ */
+template <typename T, typename S>
+void proyeccionFreivalds(unsigned long long semilla, const S *A, long ld, long fila0, long filas, long columnas,
+        std::vector<typename TipoControl<T>::tipo> &w) {
+    typedef typename TipoControl<T>::tipo Control;
+    std::vector<Control> r(filas);
+    for (long i = 0; i < filas; i++) {
+        r[i] = pesoFreivalds<T>(semilla, fila0 + i);
+    }
+    w.assign(columnas, 0);
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        long inicio = 0, fin = columnas;
+#ifdef _OPENMP
+        filasHilo(columnas, omp_get_thread_num(), omp_get_num_threads(), inicio, fin);
+#endif
+        for (long i = 0; i < filas; i++) {
+            for (long j = inicio; j < fin; j++) {
+                w[j] += r[i] * (Control) A[i * ld + j];
+            }
+        }
+    }
+}
+
+// w = r^T A de las filas locales de una matriz CSR, sobre las posiciones del x local
+template <typename T>
+void proyeccionFreivalds(unsigned long long semilla, const MatrizCSR<T> &A, long fila0, long posiciones,
+        std::vector<typename TipoControl<T>::tipo> &w) {
+    typedef typename TipoControl<T>::tipo Control;
+    w.assign(posiciones, 0);
+    for (long i = 0; i < A.filas; i++) {
+        Control r = pesoFreivalds<T>(semilla, fila0 + i);
+        for (long p = A.inicioFila[i]; p < A.inicioFila[i + 1]; p++) {
+            w[A.columnaLocal[p]] += r * (Control) A.valor[p];
+        }
+    }
+}
+
+/*
+ Comprueba los k vectores de y = A x con la proyeccion 'w' de cada proceso y su
+ trozo 'x' (las 'posiciones' de w, k valores por posicion). Cada proceso aporta
+ tambien r^T y de las 'filas' posiciones de y que tiene, a partir de la
+ 'fila0': el proceso 0 todas si y se ha recogido en el, o cada proceso su trozo
+ si y sigue repartido. Lo llaman todos los procesos de 'comunicador'; devuelve
+ en el proceso 0 el numero de vectores que no cumplen la igualdad.
+ */
+template <typename T>
+long compruebaFreivalds(unsigned long long semilla, const std::vector<typename TipoControl<T>::tipo> &w, const T *x,
+        int k, const T *y, long fila0, long filas, MPI_Comm comunicador) {
+    typedef typename TipoControl<T>::tipo Control;
+    int id;
+    MPI_Comm_rank(comunicador, &id);
+    // w^T x y r^T y de cada vector; la suma de |r_i y_i| da la escala del error, y tras ella van
+    // las filas de y, el numero de terminos de r^T y
+    std::vector<Control> local(2 * k, 0), total(2 * k, 0);
+    std::vector<double> escalaLocal(k + 1, 0), escala(k + 1, 0);
+    escalaLocal[k] = filas;
+    for (size_t j = 0; j < w.size(); j++) {
+        for (int v = 0; v < k; v++) {
+            local[v] += w[j] * (Control) x[j * k + v];
+        }
+    }
+    for (long i = 0; i < filas; i++) {
+        Control r = pesoFreivalds<T>(semilla, fila0 + i);
+        for (int v = 0; v < k; v++) {
+            Control termino = r * (Control) y[i * k + v];
+            local[k + v] += termino;
+            escalaLocal[v] += std::fabs((double) termino);
+        }
+    }
+    MPI_Reduce(&local[0], &total[0], 2 * k, tipoMPIControl<T>(), MPI_SUM, 0, comunicador);
+    MPI_Reduce(&escalaLocal[0], &escala[0], k + 1, MPI_DOUBLE, MPI_SUM, 0, comunicador);
+    if (id != 0) {
+        return 0;
+    }
+
+    long fallos = 0;
+    for (int v = 0; v < k; v++) {
+        if (std::is_integral<T>::value) {
+            fallos += (total[k + v] != total[v]);
+        } else {
+            fallos += std::fabs((double) total[k + v] - (double) total[v]) > toleranciaSuma<T>((long) escala[k]) * (escala[v] > 1 ? escala[v] : 1);
+        }
+    }
+    return fallos;
+}
+
+// Fila de control del bloque: la suma de cada una de sus columnas, en el tipo T de y
+template <typename S, typename T>
+void sumaColumnas(const S *A, long ld, long filas, long columnas, T *suma) {
+    for (long j = 0; j < columnas; j++) {
+        suma[j] = 0;
+    }
+    for (long i = 0; i < filas; i++) {
+        for (long j = 0; j < columnas; j++) {
+            suma[j] += A[i * ld + j];
+        }
+    }
+}
+
+// Fila de control de las filas locales de una matriz CSR, sobre las posiciones del x local
+template <typename T>
+void sumaColumnas(const MatrizCSR<T> &A, long posiciones, T *suma) {
+    for (long j = 0; j < posiciones; j++) {
+        suma[j] = 0;
+    }
+    for (size_t p = 0; p < A.valor.size(); p++) {
+        suma[A.columnaLocal[p]] += A.valor[p];
+    }
+}
+
+/*
+ Comprobacion ABFT de un producto local: la suma de las 'filas' posiciones de y
+ (k valores cada una) debe ser igual al producto de la fila de control por x
+ ('columnas' posiciones). Devuelve el numero de vectores que no cumplen.
+ */
+template <typename T>
+int compruebaControl(const T *filaControl, long columnas, const T *x, const T *y, long filas, int k) {
+    std::vector<T> control(k), suma(k, 0);
+    std::vector<double> escala(k, 0);
+    productoBloqueSecuencial(filaControl, columnas, x, &control[0], 1, columnas, k);
+    for (long i = 0; i < filas; i++) {
+        for (int v = 0; v < k; v++) {
+            suma[v] += y[i * k + v];
+            escala[v] += std::fabs((double) y[i * k + v]);
+        }
+    }
+    int fallos = 0;
+    for (int v = 0; v < k; v++) {
+        if (std::is_integral<T>::value) {
+            fallos += (suma[v] != control[v]);
+        } else {
+            double diferencia = std::fabs((double) suma[v] - (double) control[v]);
+            fallos += diferencia > toleranciaSuma<T>(filas + columnas) * (escala[v] > 1 ? escala[v] : 1);
+        }
+    }
+    return fallos;
+}
+
+#endif